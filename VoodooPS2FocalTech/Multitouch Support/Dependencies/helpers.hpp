@@ -32,6 +32,13 @@ inline void setOSDictionaryNumber(OSDictionary* dictionary, const char * key, UI
     }
 }
 
+inline void setOSDictionaryNumber64(OSDictionary* dictionary, const char * key, UInt64 number) {
+    if (OSNumber* os_number = OSNumber::withNumber(number, 64)) {
+        dictionary->setObject(key, os_number);
+        os_number->release();
+    }
+}
+
 enum VoodooI2CState {
     kVoodooI2CStateOff = 0,
     kVoodooI2CStateOn = 1
@@ -0,0 +1,107 @@
+//
+//  VoodooPS2EdgeEngine.cpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#include "VoodooPS2EdgeEngine.hpp"
+#include "../VoodooPS2FrameFeatures.hpp"
+#include "../VoodooPS2DigitiserTransducer.hpp"
+
+#define super VoodooPS2MultitouchEngine
+OSDefineMetaClassAndStructors(VoodooPS2EdgeEngine, VoodooPS2MultitouchEngine);
+
+UInt8 VoodooPS2EdgeEngine::getScore() {
+    return kEdgeEngineScore;
+}
+
+MultitouchReturn VoodooPS2EdgeEngine::handleInterruptReport(VoodooI2CMultitouchEvent event, AbsoluteTime timestamp) {
+    VoodooPS2FrameFeatures* features = event.features;
+    if (!features)
+        return MultitouchReturnContinue;
+
+    int count = features->contactCount();
+    bool landed = count == 1 && last_count == 0;
+    last_count = count;
+
+    if (count != 1) {
+        scroll_zone = kEdgeNone;
+        return MultitouchReturnContinue;
+    }
+
+    VoodooPS2DigitiserTransducer* contact = features->contact(0);
+    UInt32 x = contact->coordinates.x.value();
+    UInt32 y = contact->coordinates.y.value();
+
+    if (landed) {
+        // only a finger that lands in a zone scrolls, the corner belongs to the right edge
+        scroll_zone = zoneOf(x, y);
+        if (scroll_zone & kEdgeRight)
+            scroll_zone = kEdgeRight;
+        remainder = 0;
+        last_x = x;
+        last_y = y;
+        return scroll_zone ? MultitouchReturnBreak : MultitouchReturnContinue;
+    }
+
+    if (!scroll_zone)
+        return MultitouchReturnContinue;
+
+    VoodooPS2ScrollEvent scroll_event;
+    scroll_event.vertical = 0;
+    scroll_event.horizontal = 0;
+    scroll_event.timestamp = timestamp;
+
+    if (scroll_zone == kEdgeRight) {
+        remainder += (SInt32) y - (SInt32) last_y;
+        scroll_event.vertical = -(remainder / kEdgeScrollDivisor);
+    } else {
+        remainder += (SInt32) x - (SInt32) last_x;
+        scroll_event.horizontal = -(remainder / kEdgeScrollDivisor);
+    }
+    remainder %= kEdgeScrollDivisor;
+    last_x = x;
+    last_y = y;
+
+    IOService* driver = interface ? interface->getProvider() : NULL;
+    if (driver && (scroll_event.vertical || scroll_event.horizontal))
+        driver->message(kVoodooPS2MultitouchScroll, this, &scroll_event);
+
+    return MultitouchReturnBreak;
+}
+
+UInt32 VoodooPS2EdgeEngine::readWidth(const char* key, UInt32 fallback) {
+    OSNumber* width = OSDynamicCast(OSNumber, getProperty(key));
+    if (!width)
+        return fallback;
+
+    return width->unsigned32BitValue() > kEdgeMaxWidth ? kEdgeMaxWidth : width->unsigned32BitValue();
+}
+
+#ifdef FOCALTECH_PROFILING
+void VoodooPS2EdgeEngine::resetState() {
+    super::resetState();
+    last_count = 0;
+    scroll_zone = kEdgeNone;
+    remainder = 0;
+}
+#endif
+
+bool VoodooPS2EdgeEngine::start(IOService* provider) {
+    OSBoolean* enabled = OSDynamicCast(OSBoolean, getProperty("Enabled"));
+    if (enabled && !enabled->isTrue())
+        return false;
+
+    // the zones must be known before super::start registers the engine
+    // for frames, a zone of width 0 lies beyond the pad and never matches
+    VoodooPS2MultitouchInterface* pad = OSDynamicCast(VoodooPS2MultitouchInterface, provider);
+    if (!pad)
+        return false;
+    UInt32 right_width = readWidth("RightEdgeWidth", kEdgeDefaultRightWidth);
+    UInt32 bottom_width = readWidth("BottomEdgeWidth", kEdgeDefaultBottomWidth);
+    right_boundary = pad->logical_max_x + 1 - pad->logical_max_x * right_width / 100;
+    bottom_boundary = pad->logical_max_y + 1 - pad->logical_max_y * bottom_width / 100;
+
+    return super::start(provider);
+}
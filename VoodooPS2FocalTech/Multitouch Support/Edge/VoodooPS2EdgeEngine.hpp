@@ -0,0 +1,70 @@
+//
+//  VoodooPS2EdgeEngine.hpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#ifndef VoodooPS2EdgeEngine_hpp
+#define VoodooPS2EdgeEngine_hpp
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOKitKeys.h>
+#include <IOKit/IOService.h>
+
+#include "../VoodooPS2MultitouchInterface.hpp"
+#include "../VoodooPS2MultitouchEngine.hpp"
+
+#define kEdgeEngineScore        0xA0
+
+// Edge scrolling moves one line per this many logical units
+#define kEdgeScrollDivisor      16
+
+// Zone widths in percent of the pad, the personality may override them
+#define kEdgeDefaultRightWidth  8
+#define kEdgeDefaultBottomWidth 10
+#define kEdgeMaxWidth           50
+
+/* Scrolls with a single finger that lands in the right edge (vertically) or in the bottom edge (horizontally)
+ *
+ * The zone boundaries are computed once when the engine starts, checking a contact costs two comparisons. Scores above
+ * <VoodooPS2NativeEngine> so an edge scroll is not seen as pointer movement.
+ */
+
+class EXPORT VoodooPS2EdgeEngine : public VoodooPS2MultitouchEngine {
+    OSDeclareDefaultStructors(VoodooPS2EdgeEngine);
+
+ public:
+    UInt8 getScore() override;
+
+    MultitouchReturn handleInterruptReport(VoodooI2CMultitouchEvent event, AbsoluteTime timestamp) override;
+
+    bool start(IOService* provider) override;
+
+#ifdef FOCALTECH_PROFILING
+    void resetState() override;
+#endif
+
+ private:
+    enum {
+        kEdgeNone   = 0,
+        kEdgeRight  = 1 << 0,
+        kEdgeBottom = 1 << 1
+    };
+
+    UInt32 right_boundary = 0;
+    UInt32 bottom_boundary = 0;
+
+    int last_count = 0;
+    int scroll_zone = kEdgeNone;
+    UInt32 last_x, last_y;
+    SInt32 remainder = 0;
+
+    int zoneOf(UInt32 x, UInt32 y) const {
+        return (x >= right_boundary) * kEdgeRight | (y >= bottom_boundary) * kEdgeBottom;
+    }
+
+    UInt32 readWidth(const char* key, UInt32 fallback);
+};
+
+#endif /* VoodooPS2EdgeEngine_hpp */
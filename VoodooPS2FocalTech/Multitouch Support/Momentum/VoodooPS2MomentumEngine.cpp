@@ -0,0 +1,177 @@
+//
+//  VoodooPS2MomentumEngine.cpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#include "VoodooPS2MomentumEngine.hpp"
+#include "../VoodooPS2FrameFeatures.hpp"
+
+#define super VoodooPS2MultitouchEngine
+OSDefineMetaClassAndStructors(VoodooPS2MomentumEngine, VoodooPS2MultitouchEngine);
+
+static bool belowMinVelocity(SInt32 vx, SInt32 vy) {
+    return vx < kMomentumMinVelocity && vx > -kMomentumMinVelocity && vy < kMomentumMinVelocity && vy > -kMomentumMinVelocity;
+}
+
+UInt8 VoodooPS2MomentumEngine::getScore() {
+    return kMomentumEngineScore;
+}
+
+MultitouchReturn VoodooPS2MomentumEngine::handleInterruptReport(VoodooI2CMultitouchEvent event, AbsoluteTime timestamp) {
+    VoodooPS2FrameFeatures* features = event.features;
+    if (!features)
+        return MultitouchReturnContinue;
+
+    int count = features->contactCount();
+
+    if (count == 2) {
+        UInt32 x, y;
+        SInt32 vx0, vy0, vx1, vy1;
+
+        stopMomentum();
+        features->centroid(&x, &y);
+
+        if (scrolling) {
+            scroll((SInt64) x - last_x, (SInt64) y - last_y, timestamp);
+
+            if (features->velocity(0, &vx0, &vy0) && features->velocity(1, &vx1, &vy1)) {
+                velocity_x = (vx0 + vx1) / 2;
+                velocity_y = (vy0 + vy1) / 2;
+            }
+        } else {
+            remainder_x = remainder_y = 0;
+            velocity_x = velocity_y = 0;
+        }
+
+        scrolling = true;
+        last_x = x;
+        last_y = y;
+        return MultitouchReturnBreak;
+    }
+
+    if (scrolling) {
+        scrolling = false;
+        startMomentum(timestamp);
+        return MultitouchReturnBreak;
+    }
+
+    if (coasting && count) {
+        // the second finger of the scroll is still lifting
+        if (count == 1 && toNanoseconds(timestamp - lift_time) < kMomentumLiftGrace)
+            return MultitouchReturnBreak;
+
+        // a new touch catches the content
+        stopMomentum();
+    }
+
+    return MultitouchReturnContinue;
+}
+
+void VoodooPS2MomentumEngine::scroll(SInt64 dx, SInt64 dy, AbsoluteTime timestamp) {
+    const SInt64 line = 1000 * kMomentumScrollDivisor;
+
+    remainder_x += dx * 1000;
+    remainder_y += dy * 1000;
+
+    VoodooPS2ScrollEvent scroll_event;
+    scroll_event.horizontal = (SInt32) -(remainder_x / line);
+    scroll_event.vertical = (SInt32) -(remainder_y / line);
+    scroll_event.timestamp = timestamp;
+
+    remainder_x %= line;
+    remainder_y %= line;
+
+    if (!scroll_event.horizontal && !scroll_event.vertical)
+        return;
+
+    IOService* driver = interface ? interface->getProvider() : NULL;
+    if (driver)
+        driver->message(kVoodooPS2MultitouchScroll, this, &scroll_event);
+}
+
+void VoodooPS2MomentumEngine::startMomentum(AbsoluteTime timestamp) {
+    if (!timer || belowMinVelocity(velocity_x, velocity_y))
+        return;
+
+    coasting = true;
+    lift_time = timestamp;
+    setTimeoutMS(timer, kMomentumInterval);
+}
+
+void VoodooPS2MomentumEngine::stopMomentum() {
+    if (!coasting)
+        return;
+
+    coasting = false;
+    cancelTimeout(timer);
+}
+
+void VoodooPS2MomentumEngine::momentumTick(IOTimerEventSource* sender) {
+    if (!coasting)
+        return;
+
+    // distance travelled during one tick, in logical units scaled by 1000
+    AbsoluteTime now = currentTime();
+    remainder_x += (SInt64) velocity_x * kMomentumInterval;
+    remainder_y += (SInt64) velocity_y * kMomentumInterval;
+    scroll(0, 0, now);
+
+    // integer decay keeps the curve identical from run to run
+    velocity_x = (SInt32) ((SInt64) velocity_x * kMomentumDecay / 256);
+    velocity_y = (SInt32) ((SInt64) velocity_y * kMomentumDecay / 256);
+
+    if (belowMinVelocity(velocity_x, velocity_y)) {
+        coasting = false;
+        return;
+    }
+
+    setTimeoutMS(timer, kMomentumInterval);
+}
+
+#ifdef FOCALTECH_PROFILING
+void VoodooPS2MomentumEngine::resetState() {
+    super::resetState();
+    if (timer)
+        cancelTimeout(timer);
+    scrolling = false;
+    coasting = false;
+    lift_time = 0;
+    velocity_x = velocity_y = 0;
+    remainder_x = remainder_y = 0;
+}
+#endif
+
+bool VoodooPS2MomentumEngine::start(IOService* provider) {
+    OSBoolean* enabled = OSDynamicCast(OSBoolean, getProperty("Enabled"));
+    if (enabled && !enabled->isTrue())
+        return false;
+
+    // the timer must exist before super::start registers the engine for frames
+    IOWorkLoop* work_loop = getWorkLoop();
+    timer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &VoodooPS2MomentumEngine::momentumTick));
+    if (!work_loop || !timer || work_loop->addEventSource(timer) != kIOReturnSuccess) {
+        OSSafeReleaseNULL(timer);
+        return false;
+    }
+
+    if (!super::start(provider)) {
+        work_loop->removeEventSource(timer);
+        OSSafeReleaseNULL(timer);
+        return false;
+    }
+
+    return true;
+}
+
+void VoodooPS2MomentumEngine::stop(IOService* provider) {
+    if (timer) {
+        coasting = false;
+        cancelTimeout(timer);
+        getWorkLoop()->removeEventSource(timer);
+        OSSafeReleaseNULL(timer);
+    }
+
+    super::stop(provider);
+}
@@ -0,0 +1,75 @@
+//
+//  VoodooPS2MomentumEngine.hpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#ifndef VoodooPS2MomentumEngine_hpp
+#define VoodooPS2MomentumEngine_hpp
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOKitKeys.h>
+#include <IOKit/IOService.h>
+#include <IOKit/IOTimerEventSource.h>
+
+#include "../VoodooPS2MultitouchInterface.hpp"
+#include "../VoodooPS2MultitouchEngine.hpp"
+
+#define kMomentumEngineScore        0x40
+
+// Two-finger drags scroll by one line per this many logical units
+#define kMomentumScrollDivisor      16
+
+// Momentum ticks at display rate, each tick keeps kMomentumDecay/256 of the
+// velocity until it drops below kMomentumMinVelocity (logical units per second)
+#define kMomentumInterval           16          // ms
+#define kMomentumDecay              243
+#define kMomentumMinVelocity        160
+
+// A finger lifting a little after the other one does not cancel momentum
+#define kMomentumLiftGrace          50000000    // 50 ms
+
+/* Turns two-finger drags into scroll wheel events and keeps scrolling with decaying speed after the fingers lift
+ *
+ * Scores below <VoodooPS2NativeEngine>, so it only sees frames when VoodooInput is not attached.
+ */
+
+class EXPORT VoodooPS2MomentumEngine : public VoodooPS2MultitouchEngine {
+    OSDeclareDefaultStructors(VoodooPS2MomentumEngine);
+
+ public:
+    UInt8 getScore() override;
+
+    MultitouchReturn handleInterruptReport(VoodooI2CMultitouchEvent event, AbsoluteTime timestamp) override;
+
+    bool start(IOService* provider) override;
+    void stop(IOService* provider) override;
+
+#ifdef FOCALTECH_PROFILING
+    void resetState() override;
+#endif
+
+ private:
+    IOTimerEventSource* timer = NULL;
+
+    bool scrolling = false;
+    bool coasting = false;
+    UInt32 last_x, last_y;
+    AbsoluteTime lift_time = 0;
+
+    // logical units per second
+    SInt32 velocity_x = 0;
+    SInt32 velocity_y = 0;
+
+    // logical units scaled by 1000, carried between scroll events
+    SInt64 remainder_x = 0;
+    SInt64 remainder_y = 0;
+
+    void scroll(SInt64 dx, SInt64 dy, AbsoluteTime timestamp);
+    void startMomentum(AbsoluteTime timestamp);
+    void stopMomentum();
+    void momentumTick(IOTimerEventSource* sender);
+};
+
+#endif /* VoodooPS2MomentumEngine_hpp */
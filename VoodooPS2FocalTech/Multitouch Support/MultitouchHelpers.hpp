@@ -12,16 +12,70 @@
 #include <IOKit/IOLib.h>
 #include <IOKit/IOService.h>
 
+class VoodooPS2FrameFeatures;
+
 typedef struct {
     UInt8 contact_count;
     OSArray* transducers;
+    VoodooPS2FrameFeatures* features;
 } VoodooI2CMultitouchEvent;
 
+/* Largest number of events forwarded to the engines in one batch */
+
+#define kMultitouchFrameBatchMax 8
+
 typedef UInt32 MultitouchReturn;
 
 #define MultitouchReturnContinue 0x0
 #define MultitouchReturnBreak 0x1
 
+/* One entry of a batch of multitouch events, <result> becomes *MultitouchReturnBreak* once an engine consumed the event */
+
+typedef struct {
+    VoodooI2CMultitouchEvent event;
+    AbsoluteTime timestamp;
+    MultitouchReturn result;
+} VoodooI2CMultitouchFrame;
+
+/* Messages a multitouch engine sends to the driver that publishes its <VoodooPS2MultitouchInterface>
+ *
+ * Engines producing plain pointer input (as opposed to forwarding frames to VoodooInput) hand it to the driver, which owns the
+ * IOHIPointing side. Engines call <IOService::message> directly, so the driver handles them on the engine work loop, serialised
+ * with frame delivery, not on its PS/2 work loop.
+ */
+
+enum {
+    kVoodooPS2MultitouchScroll = iokit_vendor_specific_msg(300),    // scroll (data is VoodooPS2ScrollEvent*)
+    kVoodooPS2MultitouchPointer = iokit_vendor_specific_msg(301),   // move and/or set buttons (data is VoodooPS2PointerEvent*)
+    kVoodooPS2MultitouchKeystroke = iokit_vendor_specific_msg(302)  // press and release a key combination (data is VoodooPS2KeyCombo*)
+};
+
+// Buttons of a <VoodooPS2PointerEvent>, the driver ORs them with the physical buttons
+#define kVoodooPS2ButtonLeft    0x01
+#define kVoodooPS2ButtonRight   0x02
+#define kVoodooPS2ButtonMiddle  0x04
+
+typedef struct {
+    SInt32 vertical;
+    SInt32 horizontal;
+    AbsoluteTime timestamp;
+} VoodooPS2ScrollEvent;
+
+typedef struct {
+    SInt32 dx;
+    SInt32 dy;
+    UInt32 buttons;
+    AbsoluteTime timestamp;
+} VoodooPS2PointerEvent;
+
+#define kVoodooPS2KeyComboMax   4
+
+// ADB key codes, pressed in order and released in reverse order
+typedef struct {
+    UInt16 keys[kVoodooPS2KeyComboMax];
+    UInt8 count;
+} VoodooPS2KeyCombo;
+
 #ifndef EXPORT
 #define EXPORT __attribute__((visibility("default")))
 #endif
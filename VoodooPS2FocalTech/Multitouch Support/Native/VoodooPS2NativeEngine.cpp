@@ -11,19 +11,53 @@
 #define super VoodooPS2MultitouchEngine
 OSDefineMetaClassAndStructors(VoodooPS2NativeEngine, VoodooPS2MultitouchEngine);
 
+UInt8 VoodooPS2NativeEngine::getScore() {
+    return kNativeEngineScore;
+}
+
 MultitouchReturn VoodooPS2NativeEngine::handleInterruptReport(VoodooI2CMultitouchEvent event, AbsoluteTime timestamp) {
-    if (!voodooInputInstance) {
-        return MultitouchReturnContinue;
+    VoodooI2CMultitouchFrame frame = {event, timestamp, MultitouchReturnContinue};
+    handleInterruptReports(&frame, 1);
+    return frame.result;
+}
+
+void VoodooPS2NativeEngine::handleInterruptReports(VoodooI2CMultitouchFrame* frames, UInt32 count) {
+    if (!voodooInputInstance)
+        return;
+
+    // The Force Click preference and the replay state are looked up at most
+    // once per batch, every frame still goes to VoodooInput in order
+    int force_click = -1;
+#ifdef FOCALTECH_PROFILING
+    bool replaying = __atomic_load_n(&interface->replaying, __ATOMIC_ACQUIRE);
+#endif
+
+    for (UInt32 i = 0; i < count; i++) {
+        if (frames[i].result == MultitouchReturnBreak)
+            continue;
+
+        frames[i].result = MultitouchReturnBreak;
+        if (!buildMessage(frames[i].event, frames[i].timestamp, &force_click))
+            continue;
+
+#ifdef FOCALTECH_PROFILING
+        recordMessage();
+        if (replaying)
+            continue;
+#endif
+        super::messageClient(kIOMessageVoodooInputMessage, voodooInputInstance, &message, sizeof(VoodooInputEvent));
     }
+}
 
-    message.timestamp = timestamp;
+bool VoodooPS2NativeEngine::buildMessage(const VoodooI2CMultitouchEvent& event, AbsoluteTime timestamp, int* force_click) {
+    message.timestamp = eventTime(timestamp);
     message.contact_count = event.contact_count;
     memset(message.transducers, 0, VOODOO_INPUT_MAX_TRANSDUCERS * sizeof(VoodooInputTransducer));
     
     VoodooPS2DigitiserTransducer* transducer = (VoodooPS2DigitiserTransducer*) event.transducers->getObject(0);
 
     if (!transducer)
-        return MultitouchReturnBreak;
+        return false;
     
     if (transducer->type == kDigitiserTransducerStylus)
         stylus_check = 1;
@@ -46,49 +80,124 @@ MultitouchReturn VoodooPS2NativeEngine::handleInterruptReport(VoodooI2CMultitouc
         inputTransducer->isPhysicalButtonDown = transducer->physical_button.value();
         
         inputTransducer->currentCoordinates.x = transducer->coordinates.x.value();
-        inputTransducer->previousCoordinates.x = transducer->coordinates.x.last.value;
+        inputTransducer->previousCoordinates.x = transducer->coordinates.x.last();
         
         inputTransducer->currentCoordinates.y = transducer->coordinates.y.value();
-        inputTransducer->previousCoordinates.y = transducer->coordinates.y.last.value;
+        inputTransducer->previousCoordinates.y = transducer->coordinates.y.last();
         inputTransducer->supportsPressure = false;
-        inputTransducer->timestamp = timestamp;
+        inputTransducer->timestamp = message.timestamp;
 
-        // TODO: does VoodooI2C know width(s)? how does it measure pressure?
-        inputTransducer->currentCoordinates.width = transducer->tip_pressure.value() / 2;
-        inputTransducer->previousCoordinates.width = transducer->tip_pressure.last.value / 2;
-
-        inputTransducer->currentCoordinates.pressure = transducer->tip_pressure.value();
-        inputTransducer->previousCoordinates.pressure = transducer->tip_pressure.last.value;
+        // FocalTech reports neither width nor pressure, both stay zeroed
 
         // Force Touch emulation
         // The button state is saved in the first transducer
-        if (((VoodooPS2DigitiserTransducer*) event.transducers->getObject(0))->physical_button.value() && isForceClickEnabled()) {
-            inputTransducer->supportsPressure = true;
-            inputTransducer->isPhysicalButtonDown = 0x0;
-            inputTransducer->currentCoordinates.pressure = 0xff;
-            inputTransducer->currentCoordinates.width = 10;
+        if (((VoodooPS2DigitiserTransducer*) event.transducers->getObject(0))->physical_button.value()) {
+            if (*force_click < 0)
+                *force_click = isForceClickEnabled();
+            if (*force_click) {
+                inputTransducer->supportsPressure = true;
+                inputTransducer->isPhysicalButtonDown = 0x0;
+                inputTransducer->currentCoordinates.pressure = 0xff;
+                inputTransducer->currentCoordinates.width = 10;
+            }
         }
     }
     
     // set the thumb to improve 4F pinch and spread gesture and cross-screen dragging
-    if (event.contact_count >= 4 || transducer->physical_button.value()) {
-        // simple thumb detection: to find the lowest finger touch in the vertical direction.
-        UInt32 y_max = 0;
-        int thumb_index = 0;
-        for (int i = 0; i < event.contact_count; i++) {
-            VoodooInputTransducer* inputTransducer = &message.transducers[i];
-            if (inputTransducer->isValid && inputTransducer->currentCoordinates.y >= y_max) {
-                y_max = inputTransducer->currentCoordinates.y;
-                thumb_index = i;
+    if (event.features) {
+        int thumb_index = trackThumb(event.features, event.contact_count >= 4 || transducer->physical_button.value(), timestamp) - stylus_check;
+        if (thumb_index >= 0 && thumb_index < event.contact_count)
+            message.transducers[thumb_index].fingerType = kMT2FingerTypeThumb;
+    }
+
+    return true;
+}
+
+#ifdef FOCALTECH_PROFILING
+void VoodooPS2NativeEngine::recordMessage() {
+    OutputRecord* record = &interface->output_record;
+
+    record->event(kOutputVoodooInput);
+    record->field(kFieldContacts, message.contact_count);
+    for (int i = 0; i < message.contact_count && i < VOODOO_INPUT_MAX_TRANSDUCERS; i++) {
+        VoodooInputTransducer* transducer = &message.transducers[i];
+        record->field(kFieldFinger, transducer->fingerType);
+        record->field(kFieldId, transducer->secondaryId);
+        record->field(kFieldType, transducer->type);
+        record->field(kFieldValid, transducer->isValid);
+        record->field(kFieldActive, transducer->isTransducerActive);
+        record->field(kFieldButton, transducer->isPhysicalButtonDown);
+        record->field(kFieldForceTouch, transducer->supportsPressure);
+        record->field(kFieldX, transducer->currentCoordinates.x);
+        record->field(kFieldY, transducer->currentCoordinates.y);
+        record->field(kFieldPreviousX, transducer->previousCoordinates.x);
+        record->field(kFieldPreviousY, transducer->previousCoordinates.y);
+        record->field(kFieldPressure, transducer->currentCoordinates.pressure);
+        record->field(kFieldWidth, transducer->currentCoordinates.width);
+    }
+}
+#endif
+
+int VoodooPS2NativeEngine::trackThumb(VoodooPS2FrameFeatures* features, bool classify, AbsoluteTime timestamp) {
+    // The thumb is bound to a contact: it is classified once, as the lowest
+    // finger touch in the vertical direction, and then kept for the contact's
+    // lifetime unless another contact is clearly and persistently lower.
+    int thumb = -1;
+    for (int i = 0; i < features->contactCount() && thumb_id != kThumbNone; i++) {
+        if (features->contact(i)->secondary_id == thumb_id) {
+            thumb = i;
+            break;
+        }
+    }
+
+    if (thumb < 0) {
+        // the thumb lifted (or there never was one)
+        thumb_id = kThumbNone;
+        thumb_challenger_id = kThumbNone;
+
+        if (!classify)
+            return -1;
+
+        thumb = features->lowestContact();
+        if (thumb < 0)
+            return -1;
+
+        thumb_id = features->contact(thumb)->secondary_id;
+        return features->transducerIndex(thumb);
+    }
+
+    int lowest = features->lowestContact();
+    if (lowest != thumb && features->contact(lowest)->coordinates.y.value() > features->contact(thumb)->coordinates.y.value() + kThumbSwitchMargin) {
+        SInt32 challenger_id = features->contact(lowest)->secondary_id;
+
+        if (challenger_id != thumb_challenger_id) {
+            thumb_challenger_id = challenger_id;
+            thumb_challenge_start = timestamp;
+        } else {
+            if (toNanoseconds(timestamp - thumb_challenge_start) >= kThumbSwitchHoldTime) {
+                thumb_id = challenger_id;
+                thumb_challenger_id = kThumbNone;
+                thumb = lowest;
             }
         }
-        message.transducers[thumb_index].fingerType = kMT2FingerTypeThumb;
+    } else {
+        thumb_challenger_id = kThumbNone;
     }
-        
-    super::messageClient(kIOMessageVoodooInputMessage, voodooInputInstance, &message, sizeof(VoodooInputEvent));
-    
-    return MultitouchReturnBreak;
+
+    return classify ? features->transducerIndex(thumb) : -1;
+}
+
+#ifdef FOCALTECH_PROFILING
+void VoodooPS2NativeEngine::resetState() {
+    super::resetState();
+    thumb_id = kThumbNone;
+    thumb_challenger_id = kThumbNone;
+    thumb_challenge_start = 0;
+    stylus_check = 0;
+    // read the Force Click preference again on the first frame
+    lastForceClickPropertyUpdateTime = 0;
 }
+#endif
 
 bool VoodooPS2NativeEngine::start(IOService* provider) {
     if (!super::start(provider))
@@ -117,12 +226,10 @@ bool VoodooPS2NativeEngine::start(IOService* provider) {
 }
 
 bool VoodooPS2NativeEngine::isForceClickEnabled() {
-    AbsoluteTime now_abs;
-    uint64_t diff_ns;
-    clock_get_uptime(&now_abs);
-    absolutetime_to_nanoseconds(now_abs - lastForceClickPropertyUpdateTime, &diff_ns);
+    AbsoluteTime now_abs = currentTime();
+    uint64_t diff_ns = toNanoseconds(now_abs - lastForceClickPropertyUpdateTime);
 
-    if (diff_ns < 1e9) {
+    if (diff_ns < 1000000000ULL) {
         lastForceClickPropertyUpdateTime = now_abs;
         return lastIsForceClickEnabled;
     }
@@ -20,6 +20,15 @@
 #include "../../VoodooInputMultitouch/VoodooInputTransducer.h"
 #include "../../VoodooInputMultitouch/VoodooInputMessages.h"
 
+// Ahead of the engines that only run without VoodooInput
+#define kNativeEngineScore      0x80
+
+// A resting thumb keeps its classification until another contact is lower
+// by more than the margin (logical units) for at least the hold time
+#define kThumbSwitchMargin      64
+#define kThumbSwitchHoldTime    80000000    // 80 ms
+#define kThumbNone              -1
+
 class EXPORT VoodooPS2NativeEngine : public VoodooPS2MultitouchEngine {
     OSDeclareDefaultStructors(VoodooPS2NativeEngine);
     
@@ -31,15 +40,42 @@ class EXPORT VoodooPS2NativeEngine : public VoodooPS2MultitouchEngine {
     AbsoluteTime lastForceClickPropertyUpdateTime;
 
     bool isForceClickEnabled();
+
+    SInt32 thumb_id = kThumbNone;
+    SInt32 thumb_challenger_id = kThumbNone;
+    AbsoluteTime thumb_challenge_start = 0;
+
+    int trackThumb(VoodooPS2FrameFeatures* features, bool classify, AbsoluteTime timestamp);
+
+    /* Fills <message> from one event
+     * @force_click The Force Click preference, -1 until it was read for the current batch
+     *
+     * @return *false* if the event has no transducers
+     */
+
+    bool buildMessage(const VoodooI2CMultitouchEvent& event, AbsoluteTime timestamp, int* force_click);
+
+#ifdef FOCALTECH_PROFILING
+    /* Adds the message about to be sent to the interface's output record */
+
+    void recordMessage();
+#endif
  public:
+    UInt8 getScore() override;
+
     bool start(IOService* provider) override;
     void stop(IOService* provider) override;
+
+#ifdef FOCALTECH_PROFILING
+    void resetState() override;
+#endif
     
     bool handleOpen(IOService *forClient, IOOptionBits options, void *arg) override;
     bool handleIsOpen(const IOService *forClient) const override;
     void handleClose(IOService *forClient, IOOptionBits options) override;
     
-    MultitouchReturn handleInterruptReport(VoodooI2CMultitouchEvent event, AbsoluteTime timestamp);
+    MultitouchReturn handleInterruptReport(VoodooI2CMultitouchEvent event, AbsoluteTime timestamp) override;
+    void handleInterruptReports(VoodooI2CMultitouchFrame* frames, UInt32 count) override;
  private:
     int stylus_check = 0;
 };
@@ -0,0 +1,130 @@
+//
+//  VoodooPS2SwipeEngine.cpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#include <libkern/libkern.h>
+
+#include "VoodooPS2SwipeEngine.hpp"
+#include "../VoodooPS2FrameFeatures.hpp"
+
+#define super VoodooPS2MultitouchEngine
+OSDefineMetaClassAndStructors(VoodooPS2SwipeEngine, VoodooPS2MultitouchEngine);
+
+static const char* swipe_direction_names[] = { "Up", "Down", "Left", "Right" };
+
+UInt8 VoodooPS2SwipeEngine::getScore() {
+    return kSwipeEngineScore;
+}
+
+MultitouchReturn VoodooPS2SwipeEngine::handleInterruptReport(VoodooI2CMultitouchEvent event, AbsoluteTime timestamp) {
+    VoodooPS2FrameFeatures* features = event.features;
+    if (!features)
+        return MultitouchReturnContinue;
+
+    int count = features->contactCount();
+    bool swipe_fingers = count >= kSwipeMinFingers && count <= kSwipeMaxFingers;
+    UInt32 x, y;
+
+    switch (state) {
+        case kSwipeIdle:
+            if (!swipe_fingers)
+                return MultitouchReturnContinue;
+            break;
+
+        case kSwipeTracking:
+            if (count == fingers)
+                break;
+            // a finger landed or lifted, start over with the new set
+            state = kSwipeIdle;
+            if (!swipe_fingers)
+                return count ? MultitouchReturnBreak : MultitouchReturnContinue;
+            break;
+
+        case kSwipeDone:
+            if (!count)
+                state = kSwipeIdle;
+            return count ? MultitouchReturnBreak : MultitouchReturnContinue;
+    }
+
+    features->centroid(&x, &y);
+
+    if (state == kSwipeIdle) {
+        state = kSwipeTracking;
+        fingers = count;
+        start_x = x;
+        start_y = y;
+        start_time = timestamp;
+        return MultitouchReturnBreak;
+    }
+
+    if (toNanoseconds(timestamp - start_time) > kSwipeMaxDuration) {
+        state = kSwipeDone;
+        return MultitouchReturnBreak;
+    }
+
+    SInt32 dx = (SInt32) x - (SInt32) start_x;
+    SInt32 dy = (SInt32) y - (SInt32) start_y;
+    SInt32 distance_x = dx < 0 ? -dx : dx;
+    SInt32 distance_y = dy < 0 ? -dy : dy;
+
+    if (distance_x >= kSwipeDistance && distance_x >= kSwipeDominance * distance_y) {
+        fire(dx < 0 ? kSwipeLeft : kSwipeRight);
+        state = kSwipeDone;
+    } else if (distance_y >= kSwipeDistance && distance_y >= kSwipeDominance * distance_x) {
+        fire(dy < 0 ? kSwipeUp : kSwipeDown);
+        state = kSwipeDone;
+    }
+
+    return MultitouchReturnBreak;
+}
+
+void VoodooPS2SwipeEngine::fire(int direction) {
+    VoodooPS2KeyCombo* combo = &actions[fingers - kSwipeMinFingers][direction];
+    IOService* driver = interface ? interface->getProvider() : NULL;
+
+    if (driver && combo->count)
+        driver->message(kVoodooPS2MultitouchKeystroke, this, combo);
+}
+
+void VoodooPS2SwipeEngine::loadActions() {
+    OSDictionary* config = OSDynamicCast(OSDictionary, getProperty("Actions"));
+    char name[16];
+
+    for (int finger = kSwipeMinFingers; finger <= kSwipeMaxFingers; finger++) {
+        for (int direction = 0; direction < kSwipeDirections; direction++) {
+            VoodooPS2KeyCombo* combo = &actions[finger - kSwipeMinFingers][direction];
+            combo->count = 0;
+
+            snprintf(name, sizeof(name), "%d %s", finger, swipe_direction_names[direction]);
+            OSArray* keys = config ? OSDynamicCast(OSArray, config->getObject(name)) : NULL;
+
+            for (unsigned int i = 0; keys && i < keys->getCount() && combo->count < kVoodooPS2KeyComboMax; i++) {
+                OSNumber* key = OSDynamicCast(OSNumber, keys->getObject(i));
+                if (key)
+                    combo->keys[combo->count++] = key->unsigned16BitValue();
+            }
+        }
+    }
+}
+
+#ifdef FOCALTECH_PROFILING
+void VoodooPS2SwipeEngine::resetState() {
+    super::resetState();
+    state = kSwipeIdle;
+    fingers = 0;
+    start_time = 0;
+}
+#endif
+
+bool VoodooPS2SwipeEngine::start(IOService* provider) {
+    OSBoolean* enabled = OSDynamicCast(OSBoolean, getProperty("Enabled"));
+    if (enabled && !enabled->isTrue())
+        return false;
+
+    loadActions();
+
+    return super::start(provider);
+}
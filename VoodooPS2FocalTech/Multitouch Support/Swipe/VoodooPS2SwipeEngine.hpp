@@ -0,0 +1,76 @@
+//
+//  VoodooPS2SwipeEngine.hpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#ifndef VoodooPS2SwipeEngine_hpp
+#define VoodooPS2SwipeEngine_hpp
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOKitKeys.h>
+#include <IOKit/IOService.h>
+
+#include "../VoodooPS2MultitouchInterface.hpp"
+#include "../VoodooPS2MultitouchEngine.hpp"
+
+#define kSwipeEngineScore       0x50
+
+// A swipe fires once the centroid travelled the distance (logical units)
+// along one axis, at least kSwipeDominance times further than along the
+// other, within the duration
+#define kSwipeDistance          320
+#define kSwipeDominance         2
+#define kSwipeMaxDuration       600000000   // 600 ms
+
+#define kSwipeMinFingers        3
+#define kSwipeMaxFingers        4
+
+/* Recognizes 3 and 4 finger swipes and sends a configured key combination for each direction
+ *
+ * The combinations come from the "Actions" dictionary of the personality, keyed "<fingers> <Up|Down|Left|Right>" with an array of
+ * ADB key codes each. Scores below <VoodooPS2NativeEngine>, so it only sees frames when VoodooInput is not attached.
+ */
+
+class EXPORT VoodooPS2SwipeEngine : public VoodooPS2MultitouchEngine {
+    OSDeclareDefaultStructors(VoodooPS2SwipeEngine);
+
+ public:
+    UInt8 getScore() override;
+
+    MultitouchReturn handleInterruptReport(VoodooI2CMultitouchEvent event, AbsoluteTime timestamp) override;
+
+    bool start(IOService* provider) override;
+
+#ifdef FOCALTECH_PROFILING
+    void resetState() override;
+#endif
+
+ private:
+    enum {
+        kSwipeUp,
+        kSwipeDown,
+        kSwipeLeft,
+        kSwipeRight,
+        kSwipeDirections
+    };
+
+    enum {
+        kSwipeIdle,
+        kSwipeTracking, // fingers down, waiting for the distance
+        kSwipeDone      // fired or gave up, waiting for the fingers to lift
+    };
+
+    int state = kSwipeIdle;
+    int fingers = 0;
+    UInt32 start_x, start_y;
+    AbsoluteTime start_time = 0;
+
+    VoodooPS2KeyCombo actions[kSwipeMaxFingers - kSwipeMinFingers + 1][kSwipeDirections];
+
+    void loadActions();
+    void fire(int direction);
+};
+
+#endif /* VoodooPS2SwipeEngine_hpp */
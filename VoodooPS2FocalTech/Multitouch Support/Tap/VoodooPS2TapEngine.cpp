@@ -0,0 +1,183 @@
+//
+//  VoodooPS2TapEngine.cpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#include "VoodooPS2TapEngine.hpp"
+#include "../VoodooPS2FrameFeatures.hpp"
+#include "../VoodooPS2DigitiserTransducer.hpp"
+
+#define super VoodooPS2MultitouchEngine
+OSDefineMetaClassAndStructors(VoodooPS2TapEngine, VoodooPS2MultitouchEngine);
+
+UInt8 VoodooPS2TapEngine::getScore() {
+    return kTapEngineScore;
+}
+
+MultitouchReturn VoodooPS2TapEngine::handleInterruptReport(VoodooI2CMultitouchEvent event, AbsoluteTime timestamp) {
+    VoodooPS2FrameFeatures* features = event.features;
+    if (!features)
+        return MultitouchReturnContinue;
+
+    int count = features->contactCount();
+
+    if (count) {
+        if (!touching) {
+            touching = true;
+            moved = false;
+            max_contacts = 0;
+            started = 0;
+            touch_start = timestamp;
+
+            if (tap_state == kTapPending) {
+                cancelTimeout(timer);
+                tap_state = kTapDragging;
+            }
+        }
+
+        if (count > max_contacts)
+            max_contacts = count;
+        trackContacts(features);
+        return MultitouchReturnContinue;
+    }
+
+    if (!touching)
+        return MultitouchReturnContinue;
+
+    // all fingers lifted
+    touching = false;
+
+    uint64_t duration_ns = toNanoseconds(timestamp - touch_start);
+    bool tap = !moved && duration_ns <= kTapMaxDuration && max_contacts <= 3;
+
+    if (tap_state == kTapDragging) {
+        // ends the drag, or completes the first click of a double tap
+        setButtons(0, timestamp);
+        tap_state = kTapIdle;
+
+        if (tap && max_contacts == 1) {
+            setButtons(kVoodooPS2ButtonLeft, timestamp);
+            setButtons(0, timestamp);
+        }
+        return MultitouchReturnContinue;
+    }
+
+    if (!tap)
+        return MultitouchReturnContinue;
+
+    switch (max_contacts) {
+        case 1:
+            setButtons(kVoodooPS2ButtonLeft, timestamp);
+            tap_state = kTapPending;
+            setTimeoutMS(timer, kTapDragWindow);
+            break;
+        case 2:
+            setButtons(kVoodooPS2ButtonRight, timestamp);
+            setButtons(0, timestamp);
+            break;
+        case 3:
+            setButtons(kVoodooPS2ButtonMiddle, timestamp);
+            setButtons(0, timestamp);
+            break;
+    }
+
+    return MultitouchReturnContinue;
+}
+
+void VoodooPS2TapEngine::trackContacts(VoodooPS2FrameFeatures* features) {
+    for (int i = 0, count = features->contactCount(); i < count && !moved; i++) {
+        int index = features->transducerIndex(i);
+        VoodooPS2DigitiserTransducer* contact = features->contact(i);
+        UInt32 x = contact->coordinates.x.value();
+        UInt32 y = contact->coordinates.y.value();
+
+        if (index < 0 || index >= kFrameFeaturesMaxContacts)
+            continue;
+
+        if (!(started & (1 << index))) {
+            started |= 1 << index;
+            start_x[index] = x;
+            start_y[index] = y;
+            continue;
+        }
+
+        SInt32 dx = (SInt32) x - (SInt32) start_x[index];
+        SInt32 dy = (SInt32) y - (SInt32) start_y[index];
+        if ((dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy) > kTapMaxMovement)
+            moved = true;
+    }
+}
+
+void VoodooPS2TapEngine::setButtons(UInt32 buttons, AbsoluteTime timestamp) {
+    IOService* driver = interface ? interface->getProvider() : NULL;
+    if (!driver)
+        return;
+
+    VoodooPS2PointerEvent pointer_event;
+    pointer_event.dx = 0;
+    pointer_event.dy = 0;
+    pointer_event.buttons = buttons;
+    pointer_event.timestamp = timestamp;
+    driver->message(kVoodooPS2MultitouchPointer, this, &pointer_event);
+}
+
+void VoodooPS2TapEngine::dragWindowExpired(IOTimerEventSource* sender) {
+    if (tap_state != kTapPending)
+        return;
+
+    setButtons(0, currentTime());
+    tap_state = kTapIdle;
+}
+
+#ifdef FOCALTECH_PROFILING
+void VoodooPS2TapEngine::resetState() {
+    super::resetState();
+    if (timer)
+        cancelTimeout(timer);
+    tap_state = kTapIdle;
+    touching = false;
+    moved = false;
+    max_contacts = 0;
+    touch_start = 0;
+    started = 0;
+}
+#endif
+
+bool VoodooPS2TapEngine::start(IOService* provider) {
+    OSBoolean* enabled = OSDynamicCast(OSBoolean, getProperty("Enabled"));
+    if (enabled && !enabled->isTrue())
+        return false;
+
+    // the timer must exist before super::start registers the engine for frames
+    IOWorkLoop* work_loop = getWorkLoop();
+    timer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &VoodooPS2TapEngine::dragWindowExpired));
+    if (!work_loop || !timer || work_loop->addEventSource(timer) != kIOReturnSuccess) {
+        OSSafeReleaseNULL(timer);
+        return false;
+    }
+
+    if (!super::start(provider)) {
+        work_loop->removeEventSource(timer);
+        OSSafeReleaseNULL(timer);
+        return false;
+    }
+
+    return true;
+}
+
+void VoodooPS2TapEngine::stop(IOService* provider) {
+    if (timer) {
+        cancelTimeout(timer);
+        getWorkLoop()->removeEventSource(timer);
+        OSSafeReleaseNULL(timer);
+    }
+
+    if (tap_state != kTapIdle) {
+        setButtons(0, currentTime());
+        tap_state = kTapIdle;
+    }
+
+    super::stop(provider);
+}
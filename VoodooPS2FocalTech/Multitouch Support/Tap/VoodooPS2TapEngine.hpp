@@ -0,0 +1,75 @@
+//
+//  VoodooPS2TapEngine.hpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#ifndef VoodooPS2TapEngine_hpp
+#define VoodooPS2TapEngine_hpp
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOKitKeys.h>
+#include <IOKit/IOService.h>
+#include <IOKit/IOTimerEventSource.h>
+
+#include "../VoodooPS2MultitouchInterface.hpp"
+#include "../VoodooPS2MultitouchEngine.hpp"
+
+#define kTapEngineScore         0xC0
+
+// A touch is a tap if all its fingers lift within the duration and none of
+// them moved further than the movement (|dx| + |dy|, logical units)
+#define kTapMaxDuration         180000000   // 180 ms
+#define kTapMaxMovement         48
+
+// After a one-finger tap the left button stays down this long, touching
+// again within the window turns the tap into a drag
+#define kTapDragWindow          200         // ms
+
+/* Turns 1/2/3-finger taps into left/right/middle clicks and a tap followed by a touch into a drag
+ *
+ * Scores above <VoodooPS2NativeEngine> so taps are resolved from the frame timestamps before anything else sees the frame. The engine
+ * only observes, every frame is passed on. When VoodooInput is attached tap to click should be turned off in the Trackpad preferences.
+ */
+
+class EXPORT VoodooPS2TapEngine : public VoodooPS2MultitouchEngine {
+    OSDeclareDefaultStructors(VoodooPS2TapEngine);
+
+ public:
+    UInt8 getScore() override;
+
+    MultitouchReturn handleInterruptReport(VoodooI2CMultitouchEvent event, AbsoluteTime timestamp) override;
+
+    bool start(IOService* provider) override;
+    void stop(IOService* provider) override;
+
+#ifdef FOCALTECH_PROFILING
+    void resetState() override;
+#endif
+
+ private:
+    enum {
+        kTapIdle,
+        kTapPending,    // left button down, waiting for the drag window to pass
+        kTapDragging    // left button down until the fingers lift
+    };
+
+    IOTimerEventSource* timer = NULL;
+    int tap_state = kTapIdle;
+
+    bool touching = false;
+    bool moved = false;
+    int max_contacts = 0;
+    AbsoluteTime touch_start = 0;
+
+    UInt32 started = 0;
+    UInt32 start_x[kFrameFeaturesMaxContacts];
+    UInt32 start_y[kFrameFeaturesMaxContacts];
+
+    void trackContacts(VoodooPS2FrameFeatures* features);
+    void setButtons(UInt32 buttons, AbsoluteTime timestamp);
+    void dragWindowExpired(IOTimerEventSource* sender);
+};
+
+#endif /* VoodooPS2TapEngine_hpp */
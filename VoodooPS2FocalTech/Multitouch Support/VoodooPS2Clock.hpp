@@ -0,0 +1,115 @@
+//
+//  VoodooPS2Clock.hpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#ifndef VoodooPS2Clock_hpp
+#define VoodooPS2Clock_hpp
+
+#include <IOKit/IOLib.h>
+#include <kern/clock.h>
+
+// Time source of the pipeline. Frame timestamps, typing suppression, the
+// watchdog and the engines read it instead of the system clock, so a trace
+// replay can run on virtual time: deterministic and as fast as the CPU
+// allows. It runs on mach time unless a replay switched it over. A replay
+// starts virtual time far enough in the past to end before the mach time it
+// returns to, so the clock never goes backwards.
+//
+// Virtual time stays inside the pipeline: events leave it stamped with the
+// system uptime, see <uptime>. Engine timers follow virtual time through
+// <VoodooPS2MultitouchEngine::setTimeoutMS>.
+//
+// Durations are compared in mach ticks. Where nanoseconds are needed the
+// clock converts with the timebase ratio cached at creation, as a 32.32
+// fixed-point multiply and shift, instead of asking the kernel every time.
+
+#define kTimebaseShift  32
+
+class VoodooPS2Timebase {
+ public:
+    VoodooPS2Timebase() {
+        mach_timebase_info_data_t info;
+        clock_timebase_info(&info);
+        if (!info.numer || !info.denom)
+            info.numer = info.denom = 1;
+        to_ns = ((uint64_t)info.numer << kTimebaseShift) / info.denom;
+        to_ticks = ((uint64_t)info.denom << kTimebaseShift) / info.numer;
+    }
+
+    inline uint64_t toNanoseconds(AbsoluteTime ticks) const {
+        return (uint64_t)(((unsigned __int128)ticks * to_ns) >> kTimebaseShift);
+    }
+
+    inline AbsoluteTime toTicks(uint64_t ns) const {
+        return (AbsoluteTime)(((unsigned __int128)ns * to_ticks) >> kTimebaseShift);
+    }
+
+ private:
+    uint64_t to_ns;     // numer / denom, 32.32 fixed point, exact for 1/1
+    uint64_t to_ticks;  // denom / numer
+};
+
+class VoodooPS2Clock {
+ public:
+    VoodooPS2Clock() : virtual_time(false), virtual_now(0) {}
+
+    /* The current time in mach absolute time units */
+
+    inline AbsoluteTime now() const {
+        if (__builtin_expect(isVirtual(), false))
+            return __atomic_load_n(&virtual_now, __ATOMIC_ACQUIRE);
+        return mach_absolute_time();
+    }
+
+    /* The system uptime to stamp an outgoing event with, *timestamp* itself unless it is virtual */
+
+    inline AbsoluteTime uptime(AbsoluteTime timestamp) const {
+        return __builtin_expect(isVirtual(), false) ? mach_absolute_time() : timestamp;
+    }
+
+    /* Converts a duration in mach ticks, see <VoodooPS2Timebase> */
+
+    inline uint64_t toNanoseconds(AbsoluteTime ticks) const {
+        return timebase.toNanoseconds(ticks);
+    }
+
+    inline AbsoluteTime toTicks(uint64_t ns) const {
+        return timebase.toTicks(ns);
+    }
+
+    inline bool isVirtual() const {
+        return __atomic_load_n(&virtual_time, __ATOMIC_ACQUIRE);
+    }
+
+    /* Freezes the clock at *start*, it only moves through <advance> from then on
+     *
+     * *start* plus everything the replay advances must not be later than mach time at its end.
+     */
+
+    void useVirtualTime(AbsoluteTime start) {
+        __atomic_store_n(&virtual_now, start, __ATOMIC_RELEASE);
+        __atomic_store_n(&virtual_time, true, __ATOMIC_RELEASE);
+    }
+
+    /* Moves virtual time forward by *ns* nanoseconds */
+
+    void advance(uint64_t ns) {
+        __atomic_fetch_add(&virtual_now, timebase.toTicks(ns), __ATOMIC_ACQ_REL);
+    }
+
+    /* Returns to mach time */
+
+    void useMachTime() {
+        __atomic_store_n(&virtual_time, false, __ATOMIC_RELEASE);
+    }
+
+ private:
+    volatile bool virtual_time;
+    volatile AbsoluteTime virtual_now;
+    VoodooPS2Timebase timebase;
+};
+
+#endif /* VoodooPS2Clock_hpp */
@@ -0,0 +1,240 @@
+//
+//  VoodooPS2ContactHistory.hpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#ifndef VoodooPS2ContactHistory_hpp
+#define VoodooPS2ContactHistory_hpp
+
+#include <IOKit/IOLib.h>
+
+#define kContactHistoryDepth 8
+
+/* Sliding window least-squares line fit over the last <Depth> samples of <Channels> values sharing one time axis
+ *
+ * The sums the fit needs are updated incrementally, pushing a sample and querying a slope are both O(1). Time is kept in 100us
+ * ticks relative to an origin which is moved forward every few seconds so that all sums comfortably fit into 64 bits.
+ */
+
+template <unsigned Depth, unsigned Channels>
+class LeastSquaresWindow {
+    static const SInt64 kTicksPerSecond = 10000;
+
+ public:
+    /* The regression sums of the samples in a window, a copy is enough to compute the slopes later */
+
+    struct Fit {
+        SInt64 count;
+        SInt64 sum_t;
+        SInt64 sum_tt;
+        SInt64 sum_v[Channels];
+        SInt64 sum_tv[Channels];
+
+        /* Computes the fitted slope of one channel
+         * @channel The channel
+         * @per_second Receives the slope in value units per second
+         *
+         * @return *false* if the window does not span any time yet
+         */
+
+        bool slope(unsigned channel, SInt64* per_second) const {
+            SInt64 denominator = count * sum_tt - sum_t * sum_t;
+            if (count < 2 || denominator <= 0)
+                return false;
+
+            *per_second = (count * sum_tv[channel] - sum_t * sum_v[channel]) * kTicksPerSecond / denominator;
+            return true;
+        }
+    };
+
+    void reset() {
+        count = 0;
+        head = 0;
+        origin = 0;
+        sums.count = 0;
+        sums.sum_t = 0;
+        sums.sum_tt = 0;
+        for (unsigned c = 0; c < Channels; c++)
+            sums.sum_v[c] = sums.sum_tv[c] = 0;
+    }
+
+    /* Adds a sample, dropping the oldest one once the window is full
+     * @time_ns The sample's timestamp in nanoseconds
+     * @sample <Channels> values
+     */
+
+    void push(uint64_t time_ns, const SInt64* sample) {
+        if (!count)
+            origin = time_ns;
+
+        SInt64 tick = (SInt64) ((time_ns - origin) / kTickNs);
+        if (tick >= kRebaseTicks) {
+            rebase();
+            tick = (SInt64) ((time_ns - origin) / kTickNs);
+            if (tick >= kRebaseTicks) {
+                // the window is stale, start over
+                reset();
+                origin = time_ns;
+                tick = 0;
+            }
+        }
+
+        if (count == Depth)
+            accumulate(head, -1);
+        else
+            count++;
+
+        ticks[head] = tick;
+        for (unsigned c = 0; c < Channels; c++)
+            values[head][c] = sample[c];
+        accumulate(head, 1);
+        sums.count = count;
+
+        head = (head + 1) % Depth;
+    }
+
+    /* Computes the fitted slope of one channel, see <Fit::slope> */
+
+    bool slope(unsigned channel, SInt64* per_second) const {
+        return sums.slope(channel, per_second);
+    }
+
+    /* @return The sums of the samples currently in the window */
+
+    const Fit& fit() const {
+        return sums;
+    }
+
+    unsigned samples() const {
+        return count;
+    }
+
+ private:
+    static const uint64_t kTickNs = 100000;
+    static const SInt64 kRebaseTicks = 1 << 16;
+
+    uint64_t origin;
+    SInt64 ticks[Depth];
+    SInt64 values[Depth][Channels];
+    unsigned head;
+    unsigned count;
+    Fit sums;
+
+    void accumulate(unsigned index, SInt64 sign) {
+        SInt64 t = ticks[index];
+        sums.sum_t += sign * t;
+        sums.sum_tt += sign * t * t;
+        for (unsigned c = 0; c < Channels; c++) {
+            sums.sum_v[c] += sign * values[index][c];
+            sums.sum_tv[c] += sign * t * values[index][c];
+        }
+    }
+
+    void rebase() {
+        // move the origin to the oldest sample and rebuild the sums
+        unsigned oldest = (head + Depth - count) % Depth;
+        SInt64 shift = ticks[oldest];
+        origin += shift * kTickNs;
+
+        sums.sum_t = sums.sum_tt = 0;
+        for (unsigned c = 0; c < Channels; c++)
+            sums.sum_v[c] = sums.sum_tv[c] = 0;
+
+        for (unsigned i = 0; i < count; i++) {
+            unsigned index = (oldest + i) % Depth;
+            ticks[index] -= shift;
+            accumulate(index, 1);
+        }
+    }
+};
+
+/* Position history of one contact with velocity and acceleration estimates
+ *
+ * Velocity is the least-squares slope of the last <Depth> positions, acceleration the least-squares slope of the last <Depth>
+ * velocity estimates. <update> feeds both windows, each in O(1): it computes the velocity from the position window's sums and
+ * pushes it into the velocity window. Only the acceleration slope is left until it is asked for, a sample keeps a copy of the
+ * velocity window's sums for that. Both are in logical units per second (per second squared) as of a given sample, the last
+ * <Samples> samples can be asked for so every frame of a batch sees the estimates as of that frame.
+ */
+
+template <unsigned Depth, unsigned Samples>
+class ContactMotionHistory {
+ public:
+    void reset() {
+        position.reset();
+        motion.reset();
+    }
+
+    /* Adds a position
+     *
+     * @return The id of the sample, for <velocity> and <acceleration>
+     */
+
+    UInt32 update(UInt32 x, UInt32 y, uint64_t time_ns) {
+        SInt64 p[2] = { x, y };
+        SInt64 v[2];
+        position.push(time_ns, p);
+
+        Sample* sample = &samples[next % Samples];
+        sample->moving = position.slope(0, &v[0]) && position.slope(1, &v[1]);
+        if (sample->moving) {
+            sample->vx = clamp(v[0]);
+            sample->vy = clamp(v[1]);
+            SInt64 vs[2] = { sample->vx, sample->vy };
+            motion.push(time_ns, vs);
+        }
+        sample->fit = motion.fit();
+        return next++;
+    }
+
+    bool velocity(UInt32 id, SInt32* vx, SInt32* vy) const {
+        if (next - id - 1 >= Samples || !samples[id % Samples].moving)
+            return false;
+
+        *vx = samples[id % Samples].vx;
+        *vy = samples[id % Samples].vy;
+        return true;
+    }
+
+    bool acceleration(UInt32 id, SInt32* ax, SInt32* ay) const {
+        SInt64 a[2];
+        if (next - id - 1 >= Samples || !samples[id % Samples].moving)
+            return false;
+
+        const Sample* sample = &samples[id % Samples];
+        if (!sample->fit.slope(0, &a[0]) || !sample->fit.slope(1, &a[1]))
+            return false;
+
+        *ax = clamp(a[0]);
+        *ay = clamp(a[1]);
+        return true;
+    }
+
+ private:
+    // keeps the second fit within 64 bits, far beyond anything a finger does
+    static const SInt64 kMotionLimit = 1 << 20;
+
+    struct Sample {
+        typename LeastSquaresWindow<Depth, 2>::Fit fit;   // the velocity window
+        SInt32 vx;
+        SInt32 vy;
+        bool moving;    // the position window spans time, vx and vy are valid
+    };
+
+    LeastSquaresWindow<Depth, 2> position;
+    LeastSquaresWindow<Depth, 2> motion;
+    Sample samples[Samples];
+    UInt32 next = 0;
+
+    static SInt32 clamp(SInt64 value) {
+        if (value > kMotionLimit)
+            return kMotionLimit;
+        if (value < -kMotionLimit)
+            return -kMotionLimit;
+        return (SInt32) value;
+    }
+};
+
+#endif /* VoodooPS2ContactHistory_hpp */
@@ -11,23 +11,7 @@
 #define super OSObject
 OSDefineMetaClassAndStructors(VoodooPS2DigitiserTransducer, OSObject);
 
-bool VoodooPS2DigitiserTransducer::serialize(OSSerialize* serializer) {
-    OSDictionary* temp_dictionary = OSDictionary::withCapacity(2);
-
-    bool result = false;
-
-    if (temp_dictionary) {
-        temp_dictionary->setObject(kIOHIDElementParentCollectionKey, collection);
-        temp_dictionary->serialize(serializer);
-        temp_dictionary->release();
-
-        result = true;
-    }
-    
-    return result;
-}
-
-VoodooPS2DigitiserTransducer* VoodooPS2DigitiserTransducer::transducer(DigitiserTransducerType transducer_type, IOHIDElement* digitizer_collection) {
+VoodooPS2DigitiserTransducer* VoodooPS2DigitiserTransducer::transducer(DigitiserTransducerType transducer_type) {
     VoodooPS2DigitiserTransducer* transducer = NULL;
     
     transducer = OSTypeAlloc(VoodooPS2DigitiserTransducer);
@@ -38,8 +22,6 @@ VoodooPS2DigitiserTransducer* VoodooPS2DigitiserTransducer::transducer(Digitiser
     }
     
     transducer->type        = transducer_type;
-    transducer->collection  = digitizer_collection;
-    transducer->in_range    = false;
 
 exit:
     return transducer;
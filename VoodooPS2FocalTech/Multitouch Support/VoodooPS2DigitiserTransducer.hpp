@@ -13,47 +13,57 @@
 #include <IOKit/IOKitKeys.h>
 #include <libkern/c++/OSObject.h>
 #include <libkern/c++/OSDictionary.h>
-#include <IOKit/hid/IOHIDElement.h>
 
 #ifndef EXPORT
 #define EXPORT __attribute__((visibility("default")))
 #endif
 
-struct ValueWithTime {
-    UInt16 value = 0;
-    AbsoluteTime timestamp = 0;
-};
-
-/* Tracks a <UInt16> value with the current and last value being accessible with their respective timestamps */
+/* Tracks a value together with the <Depth> values it replaced
+ *
+ * Timestamps are kept once per transducer rather than per value, every value of a transducer changes with the same report.
+ */
 
+template <typename T, unsigned Depth = 1>
 class TimeTrackedValue {
 public:
-    ValueWithTime current;
-    ValueWithTime last;
-    
-    operator bool() {
-        return (bool)current.value;
+    T history[Depth + 1] = {};
+
+    operator bool() const {
+        return (bool)history[0];
     }
-    
+
     /* Updates a timetracked value
      * @value The new value to be set
-     * @timestamp The timestamp of the new value
      */
-    
-    void update(UInt16 value, AbsoluteTime timestamp) {
-        last = current;
-        current.value = value;
-        current.timestamp = timestamp;
+
+    void update(T value) {
+        for (unsigned i = Depth; i > 0; i--)
+            history[i] = history[i - 1];
+        history[0] = value;
     }
-    
+
     /* Returns the current value */
-    
-    UInt16 value() {
-        return current.value;
+
+    T value() const {
+        return history[0];
+    }
+
+    /* Returns the value before the current one */
+
+    T last() const {
+        return history[1];
+    }
+
+    /* Returns an older value
+     * @age 0 for the current value, up to <Depth>
+     */
+
+    T previous(unsigned age) const {
+        return history[age <= Depth ? age : Depth];
     }
 };
 
-typedef TimeTrackedValue DigitiserTransducerButtonState;
+typedef TimeTrackedValue<bool> DigitiserTransducerButtonState;
 
 typedef enum {
     kDigitiserTransducerFinger,
@@ -62,80 +72,53 @@ typedef enum {
 } DigitiserTransducerType;
 
 typedef struct {
-    TimeTrackedValue x;
-    TimeTrackedValue y;
-    TimeTrackedValue z;
+    TimeTrackedValue<UInt16> x;
+    TimeTrackedValue<UInt16> y;
 } DigitiserTransducerCoordinates;
 
-typedef struct {
-    TimeTrackedValue width;
-    TimeTrackedValue height;
-} DigitiserTransducerDimensions;
-
-typedef struct {
-    TimeTrackedValue azimuth;
-    TimeTrackedValue altitude;
-    TimeTrackedValue twist;
-} DigitiserTransducerAziAltiOrentation;
-
-typedef struct {
-    TimeTrackedValue x_tilt;
-    TimeTrackedValue y_tilt;
-} DigitiserTransducerTiltOrientation;
-
-/* Represents a transducer of a physical digitiser device */
+/* Represents a finger on the touchpad
+ *
+ * Only what a FocalTech report carries is kept so that a transducer fits in a single cache line.
+ */
 
 class EXPORT VoodooPS2DigitiserTransducer : public OSObject {
     OSDeclareDefaultStructors(VoodooPS2DigitiserTransducer);
     
 public:
-    DigitiserTransducerButtonState physical_button;
-    
     DigitiserTransducerCoordinates coordinates;
-    DigitiserTransducerCoordinates last_coordinates;
-    
-    DigitiserTransducerDimensions dimensions;
-    DigitiserTransducerDimensions last_dimensions;
-    
-    DigitiserTransducerAziAltiOrentation azi_alti_orientation;
-    DigitiserTransducerTiltOrientation tilt_orientation;
-    
+
     DigitiserTransducerButtonState tip_switch;
-    TimeTrackedValue tip_pressure;
-    
-    TimeTrackedValue touch_major;
-    TimeTrackedValue touch_minor;
-    
-    SInt32 logical_max_x;
-    SInt32 logical_max_y;
-    SInt32 logical_max_z;
-    SInt32 pressure_physical_max;
+    DigitiserTransducerButtonState physical_button;
 
     UInt16 id;
     UInt16 secondary_id;
-    
-    bool in_range = false;
-    bool is_valid = false;
+
     DigitiserTransducerType type;
-    
-    IOHIDElement*  collection;
-    
-    UInt32 event_mask;
-    AbsoluteTime timestamp;
-    
-    bool serialize(OSSerialize* serializer);
-    
+    bool is_valid = false;
+
+    AbsoluteTime timestamp = 0;
+    AbsoluteTime last_timestamp = 0;
+
+    /* Starts a new report, the current timestamp becomes <last_timestamp>
+     * @timestamp The timestamp of the report
+     */
+
+    void stamp(AbsoluteTime timestamp) {
+        last_timestamp = this->timestamp;
+        this->timestamp = timestamp;
+    }
+
     /* Instantiates a new transducer
      * @transducer_type The type of transducer to be created
-     * @digitizer_collection The HID element associated to this transducer. Set to *NULL* if not in an HID context
      *
-     * @return A pointer to an instance of <VoodooI2CDigitiserTransducer>
+     * @return A pointer to an instance of <VoodooPS2DigitiserTransducer>
      */
     
-    static VoodooPS2DigitiserTransducer* transducer(DigitiserTransducerType transducer_type, IOHIDElement* digitizer_collection);
+    static VoodooPS2DigitiserTransducer* transducer(DigitiserTransducerType transducer_type);
 protected:
 private:
 };
 
+static_assert(sizeof(VoodooPS2DigitiserTransducer) <= 64, "a transducer should fit in one cache line");
 
 #endif /* VoodooPS2DigitiserTransducer_hpp */
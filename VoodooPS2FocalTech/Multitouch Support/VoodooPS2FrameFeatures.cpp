@@ -0,0 +1,189 @@
+//
+//  VoodooPS2FrameFeatures.cpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#include "VoodooPS2FrameFeatures.hpp"
+#include "VoodooPS2DigitiserTransducer.hpp"
+
+void VoodooPS2FrameFeatures::reset(VoodooI2CMultitouchEvent* event) {
+    this->event = event;
+    computed = 0;
+    motion_set = 0;
+    velocity_computed = 0;
+    velocity_valid = 0;
+    acceleration_computed = 0;
+    acceleration_valid = 0;
+}
+
+void VoodooPS2FrameFeatures::gatherContacts() {
+    if (computed & kFeatureContacts)
+        return;
+
+    contact_count = 0;
+    if (event && event->transducers) {
+        for (int i = 0, count = event->transducers->getCount(); i < count && contact_count < kFrameFeaturesMaxContacts; i++) {
+            VoodooPS2DigitiserTransducer* transducer = OSDynamicCast(VoodooPS2DigitiserTransducer, event->transducers->getObject(i));
+
+            if (!transducer || !transducer->is_valid || !transducer->tip_switch.value())
+                continue;
+
+            contacts[contact_count] = transducer;
+            contact_index[contact_count] = i;
+            contact_count++;
+        }
+    }
+
+    computed |= kFeatureContacts;
+}
+
+int VoodooPS2FrameFeatures::contactCount() {
+    gatherContacts();
+    return contact_count;
+}
+
+VoodooPS2DigitiserTransducer* VoodooPS2FrameFeatures::contact(int contact) {
+    gatherContacts();
+    return (contact >= 0 && contact < contact_count) ? contacts[contact] : NULL;
+}
+
+int VoodooPS2FrameFeatures::transducerIndex(int contact) {
+    gatherContacts();
+    return (contact >= 0 && contact < contact_count) ? contact_index[contact] : -1;
+}
+
+bool VoodooPS2FrameFeatures::centroid(UInt32* x, UInt32* y) {
+    gatherContacts();
+    if (!contact_count)
+        return false;
+
+    if (!(computed & kFeatureCentroid)) {
+        UInt32 sum_x = 0, sum_y = 0;
+        for (int i = 0; i < contact_count; i++) {
+            sum_x += contacts[i]->coordinates.x.value();
+            sum_y += contacts[i]->coordinates.y.value();
+        }
+        centroid_x = sum_x / contact_count;
+        centroid_y = sum_y / contact_count;
+        computed |= kFeatureCentroid;
+    }
+
+    *x = centroid_x;
+    *y = centroid_y;
+    return true;
+}
+
+bool VoodooPS2FrameFeatures::boundingBox(UInt32* min_x, UInt32* min_y, UInt32* max_x, UInt32* max_y) {
+    gatherContacts();
+    if (!contact_count)
+        return false;
+
+    if (!(computed & kFeatureBoundingBox)) {
+        box_min_x = box_max_x = contacts[0]->coordinates.x.value();
+        box_min_y = box_max_y = contacts[0]->coordinates.y.value();
+        for (int i = 1; i < contact_count; i++) {
+            UInt32 x = contacts[i]->coordinates.x.value();
+            UInt32 y = contacts[i]->coordinates.y.value();
+            if (x < box_min_x) box_min_x = x;
+            if (x > box_max_x) box_max_x = x;
+            if (y < box_min_y) box_min_y = y;
+            if (y > box_max_y) box_max_y = y;
+        }
+        computed |= kFeatureBoundingBox;
+    }
+
+    *min_x = box_min_x;
+    *min_y = box_min_y;
+    *max_x = box_max_x;
+    *max_y = box_max_y;
+    return true;
+}
+
+UInt32 VoodooPS2FrameFeatures::spread() {
+    if (computed & kFeatureSpread)
+        return spread_value;
+
+    UInt32 cx, cy;
+    spread_value = 0;
+    if (centroid(&cx, &cy)) {
+        UInt32 sum = 0;
+        for (int i = 0; i < contact_count; i++) {
+            SInt32 dx = (SInt32) contacts[i]->coordinates.x.value() - (SInt32) cx;
+            SInt32 dy = (SInt32) contacts[i]->coordinates.y.value() - (SInt32) cy;
+            sum += (dx < 0 ? -dx : dx) + (dy < 0 ? -dy : dy);
+        }
+        spread_value = sum / contact_count;
+    }
+
+    computed |= kFeatureSpread;
+    return spread_value;
+}
+
+int VoodooPS2FrameFeatures::lowestContact() {
+    if (computed & kFeatureLowest)
+        return lowest_contact;
+
+    gatherContacts();
+    lowest_contact = -1;
+    UInt32 y_max = 0;
+    for (int i = 0; i < contact_count; i++) {
+        if (contacts[i]->coordinates.y.value() >= y_max) {
+            y_max = contacts[i]->coordinates.y.value();
+            lowest_contact = i;
+        }
+    }
+
+    computed |= kFeatureLowest;
+    return lowest_contact;
+}
+
+void VoodooPS2FrameFeatures::setMotion(int transducer_index, const VoodooPS2ContactHistory* history, UInt32 sample) {
+    if (transducer_index < 0 || transducer_index >= kFrameFeaturesMaxContacts || !history)
+        return;
+
+    histories[transducer_index] = history;
+    samples[transducer_index] = sample;
+    motion_set |= 1 << transducer_index;
+}
+
+bool VoodooPS2FrameFeatures::velocity(int contact, SInt32* vx, SInt32* vy) {
+    int index = transducerIndex(contact);
+    if (index < 0 || !(motion_set & (1 << index)))
+        return false;
+
+    UInt32 bit = 1 << index;
+    if (!(velocity_computed & bit)) {
+        if (histories[index]->velocity(samples[index], &velocity_x[index], &velocity_y[index]))
+            velocity_valid |= bit;
+        velocity_computed |= bit;
+    }
+
+    if (!(velocity_valid & bit))
+        return false;
+
+    *vx = velocity_x[index];
+    *vy = velocity_y[index];
+    return true;
+}
+
+bool VoodooPS2FrameFeatures::acceleration(int contact, SInt32* ax, SInt32* ay) {
+    int index = transducerIndex(contact);
+    if (index < 0 || !(motion_set & (1 << index)))
+        return false;
+
+    UInt32 bit = 1 << index;
+    if (!(acceleration_computed & bit)) {
+        if (histories[index]->acceleration(samples[index], &acceleration_x[index], &acceleration_y[index]))
+            acceleration_valid |= bit;
+        acceleration_computed |= bit;
+    }
+
+    if (!(acceleration_valid & bit))
+        return false;
+
+    *ax = acceleration_x[index];
+    *ay = acceleration_y[index];
+    return true;
+}
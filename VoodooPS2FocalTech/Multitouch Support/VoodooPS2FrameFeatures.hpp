@@ -0,0 +1,138 @@
+//
+//  VoodooPS2FrameFeatures.hpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#ifndef VoodooPS2FrameFeatures_hpp
+#define VoodooPS2FrameFeatures_hpp
+
+#include <IOKit/IOLib.h>
+
+#include "MultitouchHelpers.hpp"
+#include "VoodooPS2ContactHistory.hpp"
+
+class VoodooPS2DigitiserTransducer;
+
+#define kFrameFeaturesMaxContacts 10
+
+// History samples kept per contact, every frame of a batch still finds its own
+#define kContactHistorySamples (kContactHistoryDepth + kMultitouchFrameBatchMax)
+
+typedef ContactMotionHistory<kContactHistoryDepth, kContactHistorySamples> VoodooPS2ContactHistory;
+
+/* Aggregates of a multitouch frame that several engines are interested in
+ *
+ * A feature block is attached to every event by <VoodooPS2MultitouchInterface>. Nothing is computed up front, each feature is
+ * calculated the first time an engine asks for it and cached for the remaining engines of the same frame.
+ */
+
+class VoodooPS2FrameFeatures {
+ public:
+    /* Prepares the block for a new frame, this is cheap and discards everything cached for the previous frame
+     * @event The event the features describe
+     */
+
+    void reset(VoodooI2CMultitouchEvent* event);
+
+    /* Returns the number of touching transducers */
+
+    int contactCount();
+
+    /* Returns the transducer of a touching contact
+     * @contact Index of the contact, from 0 to <contactCount> - 1
+     */
+
+    VoodooPS2DigitiserTransducer* contact(int contact);
+
+    /* Returns the index of the transducer in the event's transducer array
+     * @contact Index of the contact, from 0 to <contactCount> - 1
+     */
+
+    int transducerIndex(int contact);
+
+    /* Computes the average position of all touching contacts
+     *
+     * @return *false* if nothing is touching
+     */
+
+    bool centroid(UInt32* x, UInt32* y);
+
+    /* Computes the smallest box containing all touching contacts
+     *
+     * @return *false* if nothing is touching
+     */
+
+    bool boundingBox(UInt32* min_x, UInt32* min_y, UInt32* max_x, UInt32* max_y);
+
+    /* Returns the mean distance (|dx| + |dy|) of the touching contacts from the centroid */
+
+    UInt32 spread();
+
+    /* Returns the contact index of the lowest contact (largest y), -1 if nothing is touching */
+
+    int lowestContact();
+
+    /* Returns the velocity of a contact in logical units per second, fitted over its recent positions
+     * @contact Index of the contact, from 0 to <contactCount> - 1
+     *
+     * @return *false* if the contact has not been touching for at least two frames
+     */
+
+    bool velocity(int contact, SInt32* vx, SInt32* vy);
+
+    /* Returns the acceleration of a contact in logical units per second squared, fitted over its recent velocities
+     * @contact Index of the contact, from 0 to <contactCount> - 1
+     *
+     * @return *false* if the contact has not been touching for at least three frames
+     */
+
+    bool acceleration(int contact, SInt32* ax, SInt32* ay);
+
+    /* Tells where the motion estimates of a transducer come from, called by <VoodooPS2MultitouchInterface> before the engines run
+     * @transducer_index Index of the transducer in the event's transducer array
+     * @history The transducer's history, it computes the estimates when an engine asks for them
+     * @sample The id of this frame's sample in the history
+     */
+
+    void setMotion(int transducer_index, const VoodooPS2ContactHistory* history, UInt32 sample);
+
+ private:
+    enum {
+        kFeatureContacts    = 1 << 0,
+        kFeatureCentroid    = 1 << 1,
+        kFeatureBoundingBox = 1 << 2,
+        kFeatureSpread      = 1 << 3,
+        kFeatureLowest      = 1 << 4
+    };
+
+    VoodooI2CMultitouchEvent* event = NULL;
+    UInt32 computed = 0;
+    // by transducer: a history sample is set, the estimate was computed, it is valid
+    UInt32 motion_set = 0;
+    UInt32 velocity_computed = 0;
+    UInt32 velocity_valid = 0;
+    UInt32 acceleration_computed = 0;
+    UInt32 acceleration_valid = 0;
+
+    int contact_count = 0;
+    VoodooPS2DigitiserTransducer* contacts[kFrameFeaturesMaxContacts];
+    UInt8 contact_index[kFrameFeaturesMaxContacts];
+
+    UInt32 centroid_x, centroid_y;
+    UInt32 box_min_x, box_min_y, box_max_x, box_max_y;
+    UInt32 spread_value;
+    int lowest_contact;
+    // indexed by transducer, not by contact
+    const VoodooPS2ContactHistory* histories[kFrameFeaturesMaxContacts];
+    UInt32 samples[kFrameFeaturesMaxContacts];
+    SInt32 velocity_x[kFrameFeaturesMaxContacts];
+    SInt32 velocity_y[kFrameFeaturesMaxContacts];
+    SInt32 acceleration_x[kFrameFeaturesMaxContacts];
+    SInt32 acceleration_y[kFrameFeaturesMaxContacts];
+
+    void gatherContacts();
+};
+
+#endif /* VoodooPS2FrameFeatures_hpp */
@@ -28,12 +28,84 @@ MultitouchReturn VoodooPS2MultitouchEngine::handleInterruptReport(VoodooI2CMulti
             continue;
         
         if (transducer->tip_switch)
-            IOLog("Transducer ID: %d, X: %d, Y: %d, Z: %d, Pressure: %d\n", transducer->secondary_id, transducer->coordinates.x.value(), transducer->coordinates.y.value(), transducer->coordinates.z.value(), transducer->tip_pressure.value());
+            IOLog("Transducer ID: %d, X: %d, Y: %d\n", transducer->secondary_id, transducer->coordinates.x.value(), transducer->coordinates.y.value());
     }
 
     return MultitouchReturnContinue;
 }
 
+void VoodooPS2MultitouchEngine::handleInterruptReports(VoodooI2CMultitouchFrame* frames, UInt32 count) {
+    for (UInt32 i = 0; i < count; i++) {
+        if (frames[i].result == MultitouchReturnBreak)
+            continue;
+
+        frames[i].result = handleInterruptReport(frames[i].event, frames[i].timestamp);
+    }
+}
+
+AbsoluteTime VoodooPS2MultitouchEngine::currentTime() {
+    if (firing_time)
+        return firing_time;
+
+    const VoodooPS2Clock* clock = interface ? interface->getClock() : NULL;
+    return clock ? clock->now() : mach_absolute_time();
+}
+
+uint64_t VoodooPS2MultitouchEngine::toNanoseconds(AbsoluteTime ticks) {
+    const VoodooPS2Clock* clock = interface ? interface->getClock() : NULL;
+    if (clock)
+        return clock->toNanoseconds(ticks);
+
+    uint64_t ns;
+    absolutetime_to_nanoseconds(ticks, &ns);
+    return ns;
+}
+
+AbsoluteTime VoodooPS2MultitouchEngine::eventTime(AbsoluteTime timestamp) {
+    const VoodooPS2Clock* clock = interface ? interface->getClock() : NULL;
+    return clock ? clock->uptime(timestamp) : timestamp;
+}
+
+void VoodooPS2MultitouchEngine::setTimeoutMS(IOTimerEventSource* timer, UInt32 ms) {
+    const VoodooPS2Clock* clock = interface ? interface->getClock() : NULL;
+
+    if (clock && clock->isVirtual()) {
+        virtual_timer = timer;
+        virtual_deadline = currentTime() + clock->toTicks((uint64_t) ms * 1000000);
+        return;
+    }
+
+    timer->setTimeoutMS(ms);
+}
+
+void VoodooPS2MultitouchEngine::cancelTimeout(IOTimerEventSource* timer) {
+    if (virtual_timer == timer)
+        virtual_timer = NULL;
+
+    timer->cancelTimeout();
+}
+
+void VoodooPS2MultitouchEngine::advanceTime(AbsoluteTime now) {
+    // a timer that arms itself again fires once per deadline passed
+    while (virtual_timer && virtual_deadline <= now) {
+        IOTimerEventSource* timer = virtual_timer;
+        IOTimerEventSource::Action action = (IOTimerEventSource::Action) timer->getAction();
+
+        virtual_timer = NULL;
+        firing_time = virtual_deadline;
+        if (action)
+            action(this, timer);
+        firing_time = 0;
+    }
+}
+
+#ifdef FOCALTECH_PROFILING
+void VoodooPS2MultitouchEngine::resetState() {
+    virtual_timer = NULL;
+    firing_time = 0;
+}
+#endif
+
 bool VoodooPS2MultitouchEngine::willTerminate(IOService* provider, IOOptionBits options) {
     if (provider->isOpen(this))
         provider->close(this);
@@ -50,6 +122,9 @@ bool VoodooPS2MultitouchEngine::start(IOService* provider) {
     if (!interface)
         return false;
 
+#ifdef FOCALTECH_PROFILING
+    profile.reset();
+#endif
     interface->open(this);
 
     setProperty("VoodooI2CServices Supported", kOSBooleanTrue);
@@ -12,8 +12,10 @@
 #include <IOKit/IOLib.h>
 #include <IOKit/IOKitKeys.h>
 #include <IOKit/IOService.h>
+#include <IOKit/IOTimerEventSource.h>
 
 #include "MultitouchHelpers.hpp"
+#include "VoodooPS2Profile.hpp"
 
 class VoodooPS2MultitouchInterface;
 
@@ -25,6 +27,12 @@ class EXPORT VoodooPS2MultitouchEngine : public IOService {
  public:
     VoodooPS2MultitouchInterface* interface;
 
+#ifdef FOCALTECH_PROFILING
+    /* Cost of <handleInterruptReports> per frame, kept by the interface */
+
+    ProfileStage profile;
+#endif
+
     /* Intended to be overwritten by an inherited class to set the engine's priority
      *
      * @return The engine's score
@@ -41,6 +49,60 @@ class EXPORT VoodooPS2MultitouchEngine : public IOService {
 
     virtual MultitouchReturn handleInterruptReport(VoodooI2CMultitouchEvent event, AbsoluteTime timestamp);
 
+    /* Intended to be overwritten by an inherited class that can handle several multitouch events in one call
+     * @frames The frames to be handled, oldest first
+     * @count The number of frames
+     *
+     * Frames whose result is already *MultitouchReturnBreak* were consumed by an engine with a higher score and must be skipped.
+     * The engine sets the result of every frame it consumes to *MultitouchReturnBreak*. The default implementation forwards each
+     * remaining frame to <handleInterruptReport>.
+     */
+
+    virtual void handleInterruptReports(VoodooI2CMultitouchFrame* frames, UInt32 count);
+
+    /* The current time on the pipeline's clock, see <VoodooPS2MultitouchInterface::getClock>
+     *
+     * Engines use it instead of the system clock, so they follow a replay on virtual time.
+     */
+
+    AbsoluteTime currentTime();
+
+    /* Converts a duration on the pipeline's clock to nanoseconds, with the cached timebase */
+
+    uint64_t toNanoseconds(AbsoluteTime ticks);
+
+    /* The system uptime to stamp an event that leaves the pipeline with, see <VoodooPS2Clock::uptime> */
+
+    AbsoluteTime eventTime(AbsoluteTime timestamp);
+
+    /* Arms one of the engine's timers to fire *ms* milliseconds from <currentTime>
+     * @timer A timer owned by this engine, its action is called with the engine as owner
+     *
+     * On virtual time the timer itself is not armed, only its deadline is kept until <advanceTime> reaches it. An engine keeps
+     * one such deadline, which fits the engines that have a timer at all.
+     */
+
+    void setTimeoutMS(IOTimerEventSource* timer, UInt32 ms);
+
+    void cancelTimeout(IOTimerEventSource* timer);
+
+    /* Fires the timer armed on virtual time, for as long as its deadline is not after *now*
+     *
+     * Called by the interface while a replay moves virtual time forward. <currentTime> returns the deadline during the call.
+     */
+
+    void advanceTime(AbsoluteTime now);
+
+#ifdef FOCALTECH_PROFILING
+    /* Intended to be overwritten by an inherited class to drop the gesture in progress and cancel its timers
+     *
+     * Called on the engine work loop before and after a trace replays, so a replay neither inherits nor leaves behind live
+     * state. Must not emit events. Overrides should call the base class, which forgets the deadline kept on virtual time.
+     */
+
+    virtual void resetState();
+#endif
+
     bool willTerminate(IOService* provider, IOOptionBits options) override;
 
     /* Sets up the multitouch engine
@@ -52,6 +114,11 @@ class EXPORT VoodooPS2MultitouchEngine : public IOService {
      */
 
     virtual bool start(IOService* provider);
+
+ private:
+    IOTimerEventSource* virtual_timer = NULL;
+    AbsoluteTime virtual_deadline = 0;
+    AbsoluteTime firing_time = 0;
 };
 
 
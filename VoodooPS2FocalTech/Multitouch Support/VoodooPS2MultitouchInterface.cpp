@@ -8,23 +8,156 @@
 
 #include "VoodooPS2MultitouchInterface.hpp"
 #include "VoodooPS2MultitouchEngine.hpp"
+#include "VoodooPS2DigitiserTransducer.hpp"
 
 #define super IOService
 OSDefineMetaClassAndStructors(VoodooPS2MultitouchInterface, IOService);
 
-void VoodooPS2MultitouchInterface::handleInterruptReport(VoodooI2CMultitouchEvent event, AbsoluteTime timestamp) {
-    int i, count;
+void VoodooPS2MultitouchInterface::handleInterruptReports(VoodooI2CMultitouchFrame* frames, UInt32 count) {
+    for (UInt32 base = 0; base < count; base += kMultitouchFrameBatchMax)
+        dispatchFrames(&frames[base], (count - base < kMultitouchFrameBatchMax) ? count - base : kMultitouchFrameBatchMax);
+}
+
+void VoodooPS2MultitouchInterface::dispatchFrames(VoodooI2CMultitouchFrame* frames, UInt32 count) {
+    UInt32 i, pending = count;
     VoodooPS2MultitouchEngine* engine;
+    int j, engine_count;
+#ifdef FOCALTECH_PROFILING
+    bool publish = false;
+#endif
+
+    PROFILE_START(dispatch_start);
+
+    for (i = 0; i < count; i++) {
+        frames[i].result = MultitouchReturnContinue;
+        features[i].reset(&frames[i].event);
+        frames[i].event.features = &features[i];
+        trackMotion(&frames[i].event, frames[i].timestamp);
+    }
 
-    for (i = 0, count = engines->getCount(); i < count; i++) {
-        engine = OSDynamicCast(VoodooPS2MultitouchEngine, engines->getObject(i));
+    for (j = 0, engine_count = engines->getCount(); j < engine_count && pending; j++) {
+        engine = OSDynamicCast(VoodooPS2MultitouchEngine, engines->getObject(j));
         if (!engine)
             continue;
 
-        if (engine->handleInterruptReport(event, timestamp) == MultitouchReturnBreak)
-            break;
+        PROFILE_START(engine_start);
+        engine->handleInterruptReports(frames, count);
+        PROFILE_STOP(engine->profile, engine_start, count, publish);
+
+        for (i = 0, pending = 0; i < count; i++)
+            if (frames[i].result != MultitouchReturnBreak)
+                pending++;
+    }
+
+    PROFILE_STOP(dispatch_profile, dispatch_start, count, publish);
+#ifdef FOCALTECH_PROFILING
+    if (publish)
+        publishProfile(j);
+#endif
+}
+
+void VoodooPS2MultitouchInterface::advanceTime(AbsoluteTime now) {
+    for (int i = 0, count = engines->getCount(); i < count; i++) {
+        VoodooPS2MultitouchEngine* engine = OSDynamicCast(VoodooPS2MultitouchEngine, engines->getObject(i));
+        if (engine)
+            engine->advanceTime(now);
+    }
+}
+
+#ifdef FOCALTECH_PROFILING
+void VoodooPS2MultitouchInterface::publishOutput(OSArray* expected, const SInt32* tolerance) {
+    OSDictionary* dict = OSDictionary::withCapacity(5);
+    OSArray* events = output_record.lines();
+    OSArray* mismatches = expected ? OSArray::withCapacity(kOutputMaxMismatches) : NULL;
+    if (dict && events && (!expected || mismatches)) {
+        dict->setObject("Events", events);
+        dict->setObject("Truncated", output_record.isTruncated() ? kOSBooleanTrue : kOSBooleanFalse);
+        if (expected) {
+            UInt32 differences = output_record.compare(expected, tolerance, mismatches);
+            dict->setObject("Matched", differences ? kOSBooleanFalse : kOSBooleanTrue);
+            setOSDictionaryNumber(dict, "Differences", differences);
+            dict->setObject("Mismatches", mismatches);
+        }
+        setProperty("ReplayOutput", dict);
+    }
+    OSSafeReleaseNULL(mismatches);
+    OSSafeReleaseNULL(events);
+    OSSafeReleaseNULL(dict);
+    output_record.stop();
+}
+
+void VoodooPS2MultitouchInterface::resetState() {
+    for (int i = 0; i < kFrameFeaturesMaxContacts; i++)
+        histories[i].reset();
+
+    for (int i = 0, count = engines->getCount(); i < count; i++) {
+        VoodooPS2MultitouchEngine* engine = OSDynamicCast(VoodooPS2MultitouchEngine, engines->getObject(i));
+        if (engine)
+            engine->resetState();
+    }
+}
+
+void VoodooPS2MultitouchInterface::publishProfile(int engine_count) {
+    OSDictionary* dict = OSDictionary::withCapacity(2);
+    if (dict) {
+        dispatch_profile.serialize(dict, "Dispatch");
+        setOSDictionaryNumber(dict, "EngineCount", engine_count);
+        setProperty("Profile", dict);
+        dict->release();
+    }
+
+    for (int i = 0, count = engines->getCount(); i < count; i++) {
+        VoodooPS2MultitouchEngine* engine = OSDynamicCast(VoodooPS2MultitouchEngine, engines->getObject(i));
+        if (!engine || !(dict = OSDictionary::withCapacity(1)))
+            continue;
+
+        engine->profile.serialize(dict, "HandleInterruptReports");
+        engine->setProperty("Profile", dict);
+        dict->release();
     }
 }
+#endif
+
+void VoodooPS2MultitouchInterface::trackMotion(VoodooI2CMultitouchEvent* event, AbsoluteTime timestamp) {
+    uint64_t time_ns;
+    int i, count = event->transducers ? event->transducers->getCount() : 0;
+
+    if (clock)
+        time_ns = clock->toNanoseconds(timestamp);
+    else
+        absolutetime_to_nanoseconds(timestamp, &time_ns);
+
+    for (i = 0; i < count && i < kFrameFeaturesMaxContacts; i++) {
+        VoodooPS2DigitiserTransducer* transducer = OSDynamicCast(VoodooPS2DigitiserTransducer, event->transducers->getObject(i));
+
+        if (!transducer || !transducer->is_valid || !transducer->tip_switch.value()) {
+            histories[i].reset();
+            continue;
+        }
+
+        UInt32 sample = histories[i].update(transducer->coordinates.x.value(), transducer->coordinates.y.value(), time_ns);
+        event->features->setMotion(i, &histories[i], sample);
+    }
+}
+
+void VoodooPS2MultitouchInterface::setEngineWorkLoop(IOWorkLoop* work_loop) {
+    if (work_loop)
+        work_loop->retain();
+    OSSafeReleaseNULL(engine_work_loop);
+    engine_work_loop = work_loop;
+}
+
+IOWorkLoop* VoodooPS2MultitouchInterface::getWorkLoop() const {
+    return engine_work_loop ? engine_work_loop : super::getWorkLoop();
+}
+
+void VoodooPS2MultitouchInterface::setClock(const VoodooPS2Clock* clock) {
+    this->clock = clock;
+}
+
+const VoodooPS2Clock* VoodooPS2MultitouchInterface::getClock() const {
+    return clock;
+}
 
 bool VoodooPS2MultitouchInterface::handleOpen(IOService* forClient, IOOptionBits options, void* arg) {
     VoodooPS2MultitouchEngine* engine = OSDynamicCast(VoodooPS2MultitouchEngine, forClient);
@@ -67,6 +200,12 @@ bool VoodooPS2MultitouchInterface::start(IOService* provider) {
     if (!super::start(provider))
         return false;
 
+    for (int i = 0; i < kFrameFeaturesMaxContacts; i++)
+        histories[i].reset();
+#ifdef FOCALTECH_PROFILING
+    dispatch_profile.reset();
+#endif
+
     engines = OSOrderedSet::withCapacity(1, (OSOrderedSet::OSOrderFunction)VoodooPS2MultitouchInterface::orderEngines);
 
     setProperty(kIOFBTransformKey, 0ull, 32);
@@ -80,3 +219,12 @@ void VoodooPS2MultitouchInterface::stop(IOService* provider) {
 
     super::stop(provider);
 }
+
+void VoodooPS2MultitouchInterface::free() {
+    OSSafeReleaseNULL(engine_work_loop);
+#ifdef FOCALTECH_PROFILING
+    output_record.stop();
+#endif
+
+    super::free();
+}
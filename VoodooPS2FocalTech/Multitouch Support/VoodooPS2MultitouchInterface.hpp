@@ -12,8 +12,13 @@
 #include <IOKit/IOLib.h>
 #include <IOKit/IOKitKeys.h>
 #include <IOKit/IOService.h>
+#include <IOKit/IOWorkLoop.h>
 
 #include "MultitouchHelpers.hpp"
+#include "VoodooPS2FrameFeatures.hpp"
+#include "VoodooPS2Profile.hpp"
+#include "VoodooPS2OutputRecord.hpp"
+#include "VoodooPS2Clock.hpp"
 
 #define kIOFBTransformKey               "IOFBTransform"
 
@@ -48,14 +53,71 @@ class EXPORT VoodooPS2MultitouchInterface : public IOService {
     UInt32 physical_max_x = 0;
     UInt32 physical_max_y = 0;
 
-    /* Forwards a multitouch event to the attached multitouch engines
-     * @event The event to forward
-     * @timestamp The timestamp of the event
+#ifdef FOCALTECH_PROFILING
+    /* Everything emitted for the frames of this interface while a trace replays, by the engines and the driver, fed on the engine
+     * work loop
+     */
+
+    OutputRecord output_record;
+
+    /* Set while a trace replays, events are then only fed into <output_record> and never leave the pipeline */
+
+    volatile bool replaying = false;
+
+    /* Publishes <output_record> under "ReplayOutput" and ends the recording
+     * @expected The expected output, see <OutputRecord::compare>, NULL to only publish the events
+     * @tolerance The allowed difference per <VoodooPS2OutputTolerance> class
+     */
+
+    void publishOutput(OSArray* expected, const SInt32* tolerance);
+
+    /* Forgets the contact histories and resets every engine, see <VoodooPS2MultitouchEngine::resetState>
      *
-     * Multitouch engines with a higher <VoodooI2CMultitouchEngine::getScore` are given higher priority.
+     * Must be called on the engine work loop.
      */
 
-    void handleInterruptReport(VoodooI2CMultitouchEvent event, AbsoluteTime timestamp);
+    void resetState();
+#endif
+
+    /* Forwards a batch of multitouch events to the attached multitouch engines
+     * @frames The frames to forward, oldest first
+     * @count The number of frames
+     *
+     * Each engine is called once for the whole batch, see <VoodooPS2MultitouchEngine::handleInterruptReports>. On return the result
+     * of every frame tells whether an engine consumed it. Every event gets a fresh <VoodooPS2FrameFeatures> block.
+     */
+
+    void handleInterruptReports(VoodooI2CMultitouchFrame* frames, UInt32 count);
+
+    /* Fires the engine timers that virtual time has reached, see <VoodooPS2MultitouchEngine::advanceTime>
+     * @now The current virtual time
+     *
+     * Must be called on the engine work loop.
+     */
+
+    void advanceTime(AbsoluteTime now);
+
+    /* Sets the work loop the engines run on
+     * @work_loop The work loop frames are delivered on, retained until the interface is freed
+     *
+     * Engines get it through <getWorkLoop>, so their event sources are serialised with frame delivery.
+     */
+
+    void setEngineWorkLoop(IOWorkLoop* work_loop);
+
+    IOWorkLoop* getWorkLoop() const override;
+
+    /* Sets the clock the frames are timestamped with
+     * @clock Owned by the driver, which outlives the interface
+     *
+     * Engines read the time through <VoodooPS2MultitouchEngine::currentTime> so they stay on the same clock.
+     */
+
+    void setClock(const VoodooPS2Clock* clock);
+
+    /* @return The clock set by the driver, NULL before it is set */
+
+    const VoodooPS2Clock* getClock() const;
 
     /* Controls the open behavior of <VoodooPS2MultitouchInterface>
      * @forClient An instance of <VoodooPS2MultitouchEngine> that wishes to be a client
@@ -102,8 +164,34 @@ class EXPORT VoodooPS2MultitouchInterface : public IOService {
 
     void stop(IOService* provider) override;
 
+    void free() override;
+
  private:
     OSOrderedSet* engines;
+    IOWorkLoop* engine_work_loop = NULL;
+    const VoodooPS2Clock* clock = NULL;
+    VoodooPS2FrameFeatures features[kMultitouchFrameBatchMax];
+    VoodooPS2ContactHistory histories[kFrameFeaturesMaxContacts];
+#ifdef FOCALTECH_PROFILING
+    ProfileStage dispatch_profile;
+
+    /* Publishes the dispatch cost, and the cost of every engine on the engine itself, under "Profile"
+     * @engine_count The number of engines the frames went through
+     */
+
+    void publishProfile(int engine_count);
+#endif
+
+    /* Feeds the touching transducers of an event into their histories and hands their samples to the event's feature block
+     * @event The event, its features must already be reset
+     * @timestamp The timestamp of the event
+     *
+     * Lifted transducers start over with an empty history.
+     */
+
+    void trackMotion(VoodooI2CMultitouchEvent* event, AbsoluteTime timestamp);
+
+    void dispatchFrames(VoodooI2CMultitouchFrame* frames, UInt32 count);
 };
 
 
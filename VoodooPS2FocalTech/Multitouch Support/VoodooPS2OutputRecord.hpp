@@ -0,0 +1,313 @@
+//
+//  VoodooPS2OutputRecord.hpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#ifndef VoodooPS2OutputRecord_hpp
+#define VoodooPS2OutputRecord_hpp
+
+#include <IOKit/IOLib.h>
+#include <libkern/libkern.h>
+
+// Canonical record of everything the pipeline emits while a trace replays,
+// compiled in with FOCALTECH_PROFILING. Every event becomes one line: its
+// kind followed by name=value pairs in a fixed order, without timestamps,
+//
+//     pointer dx=3 dy=-1 buttons=0
+//
+// so the output of a replay can be kept next to its trace and diffed.
+// <OutputRecord::compare> checks a replay against such an expected output:
+// kinds, field names and their order have to match, coordinates and deltas
+// may differ by their tolerance, every other field has to match exactly.
+
+#define kOutputMaxEvents        4096
+#define kOutputMaxFields        65536
+#define kOutputMaxMismatches    16
+#define kOutputLineLength       1024
+
+enum VoodooPS2OutputEvent {
+    kOutputVoodooInput,
+    kOutputPointer,
+    kOutputScroll,
+    kOutputKeystroke,
+    kOutputEventKinds
+};
+
+enum VoodooPS2OutputField {
+    // VoodooInput, contacts then one group per transducer
+    kFieldContacts,
+    kFieldFinger,
+    kFieldId,
+    kFieldType,
+    kFieldValid,
+    kFieldActive,
+    kFieldButton,
+    kFieldForceTouch,
+    kFieldX,
+    kFieldY,
+    kFieldPreviousX,
+    kFieldPreviousY,
+    kFieldPressure,
+    kFieldWidth,
+    // relative pointer
+    kFieldDeltaX,
+    kFieldDeltaY,
+    kFieldButtons,
+    // scroll wheel
+    kFieldVertical,
+    kFieldHorizontal,
+    // key combination, count then the key codes
+    kFieldKeyCount,
+    kFieldKey,
+    kOutputFields
+};
+
+// How far a replayed field may be from the expected one
+enum VoodooPS2OutputTolerance {
+    kToleranceExact,
+    kToleranceCoordinate,   // absolute positions, logical units
+    kToleranceDelta,        // pointer and scroll deltas
+    kToleranceClasses
+};
+
+class OutputRecord {
+ public:
+    /* Starts recording, events are dropped while no recording runs
+     *
+     * @return *false* if the buffers could not be allocated
+     */
+
+    bool start() {
+        stop();
+        events = (Event*)IOMalloc(kOutputMaxEvents * sizeof(Event));
+        values = (SInt32*)IOMalloc(kOutputMaxFields * sizeof(SInt32));
+        names = (UInt8*)IOMalloc(kOutputMaxFields);
+        if (!events || !values || !names) {
+            stop();
+            return false;
+        }
+        event_count = field_count = 0;
+        truncated = false;
+        accepting = false;
+        return true;
+    }
+
+    /* Ends the recording and frees the buffers */
+
+    void stop() {
+        if (events)
+            IOFree(events, kOutputMaxEvents * sizeof(Event));
+        if (values)
+            IOFree(values, kOutputMaxFields * sizeof(SInt32));
+        if (names)
+            IOFree(names, kOutputMaxFields);
+        events = NULL;
+        values = NULL;
+        names = NULL;
+        event_count = field_count = 0;
+        accepting = false;
+    }
+
+    /* Starts the record of one emitted event, its fields follow */
+
+    void event(VoodooPS2OutputEvent kind) {
+        accepting = false;
+        if (!events || truncated)
+            return;
+        if (event_count == kOutputMaxEvents) {
+            truncated = true;
+            return;
+        }
+        events[event_count].first = field_count;
+        events[event_count].kind = kind;
+        event_count++;
+        accepting = true;
+    }
+
+    void field(VoodooPS2OutputField name, SInt64 value) {
+        if (!accepting)
+            return;
+        if (field_count == kOutputMaxFields) {
+            // drop the event that did not fit and everything after it
+            field_count = events[--event_count].first;
+            truncated = true;
+            accepting = false;
+            return;
+        }
+        values[field_count] = (SInt32)value;
+        names[field_count] = name;
+        field_count++;
+    }
+
+    /* @return *true* if events were dropped because the buffers were full */
+
+    bool isTruncated() const {
+        return truncated;
+    }
+
+    /* @return The recorded events, one OSString per event, NULL on allocation failure */
+
+    OSArray* lines() const {
+        OSArray* array = OSArray::withCapacity(event_count ? event_count : 1);
+        char line[kOutputLineLength];
+        for (UInt32 i = 0; array && i < event_count; i++) {
+            format(i, line, sizeof(line));
+            if (OSString* string = OSString::withCString(line)) {
+                array->setObject(string);
+                string->release();
+            }
+        }
+        return array;
+    }
+
+    /* Compares the recording against an expected output
+     * @expected One OSString per event, in the format of <lines>
+     * @tolerance The allowed difference per <VoodooPS2OutputTolerance> class, kToleranceExact is ignored
+     * @mismatches Receives a description of the first kOutputMaxMismatches differences, naming event and field
+     *
+     * @return The number of differences, a missing or surplus event counts once
+     */
+
+    UInt32 compare(OSArray* expected, const SInt32* tolerance, OSArray* mismatches) const {
+        UInt32 count = expected->getCount(), differences = 0;
+        char message[kOutputLineLength];
+
+        if (count != event_count || truncated) {
+            snprintf(message, sizeof(message), "expected %u events, got %u%s", count, event_count, truncated ? " (truncated)" : "");
+            report(mismatches, message, &differences);
+        }
+
+        for (UInt32 i = 0; i < count && i < event_count; i++) {
+            OSString* string = OSDynamicCast(OSString, expected->getObject(i));
+            const char* cursor = string ? string->getCStringNoCopy() : "";
+            const Event* event = &events[i];
+            UInt32 end = (i + 1 < event_count) ? events[i + 1].first : field_count;
+
+            if (!token(&cursor, eventName(event->kind), ' ')) {
+                snprintf(message, sizeof(message), "event %u: expected \"%s\", got %s", i, string ? string->getCStringNoCopy() : "", eventName(event->kind));
+                report(mismatches, message, &differences);
+                continue;
+            }
+
+            for (UInt32 j = event->first; j < end; j++) {
+                SInt64 value;
+                if (!token(&cursor, fieldName(names[j]), '=') || !number(&cursor, &value)) {
+                    snprintf(message, sizeof(message), "event %u field %u (%s): missing or malformed in the expected line", i, j - event->first, fieldName(names[j]));
+                    report(mismatches, message, &differences);
+                    break;
+                }
+                SInt64 limit = allowed(names[j], tolerance);
+                SInt64 difference = value > values[j] ? value - values[j] : values[j] - value;
+                if (difference > limit) {
+                    snprintf(message, sizeof(message), "event %u field %u (%s): expected %lld, got %d, tolerance %lld", i, j - event->first, fieldName(names[j]), (long long)value, values[j], (long long)limit);
+                    report(mismatches, message, &differences);
+                }
+            }
+
+            if (*cursor) {
+                snprintf(message, sizeof(message), "event %u: expected more fields than the %u recorded", i, end - event->first);
+                report(mismatches, message, &differences);
+            }
+        }
+
+        return differences;
+    }
+
+ private:
+    struct Event {
+        UInt32 first;   // index of its first field
+        UInt32 kind;
+    };
+
+    Event* events = NULL;
+    SInt32* values = NULL;
+    UInt8* names = NULL;
+    UInt32 event_count = 0;
+    UInt32 field_count = 0;
+    bool truncated = false;
+    bool accepting = false;
+
+    static const char* eventName(UInt32 kind) {
+        static const char* const names[kOutputEventKinds] = {"input", "pointer", "scroll", "keys"};
+        return names[kind];
+    }
+
+    static const char* fieldName(UInt8 field) {
+        static const char* const names[kOutputFields] = {
+            "contacts", "finger", "id", "type", "valid", "active", "button", "force_touch",
+            "x", "y", "prev_x", "prev_y", "pressure", "width",
+            "dx", "dy", "buttons", "vertical", "horizontal", "count", "key"
+        };
+        return names[field];
+    }
+
+    static SInt64 allowed(UInt8 field, const SInt32* tolerance) {
+        switch (field) {
+            case kFieldX:
+            case kFieldY:
+            case kFieldPreviousX:
+            case kFieldPreviousY:
+                return tolerance[kToleranceCoordinate];
+            case kFieldDeltaX:
+            case kFieldDeltaY:
+            case kFieldVertical:
+            case kFieldHorizontal:
+                return tolerance[kToleranceDelta];
+            default:
+                return 0;
+        }
+    }
+
+    void format(UInt32 index, char* line, size_t size) const {
+        UInt32 end = (index + 1 < event_count) ? events[index + 1].first : field_count;
+        size_t used = snprintf(line, size, "%s", eventName(events[index].kind));
+        for (UInt32 j = events[index].first; j < end && used < size; j++)
+            used += snprintf(line + used, size - used, " %s=%d", fieldName(names[j]), values[j]);
+    }
+
+    static void report(OSArray* mismatches, const char* message, UInt32* differences) {
+        if ((*differences)++ >= kOutputMaxMismatches || !mismatches)
+            return;
+        if (OSString* string = OSString::withCString(message)) {
+            mismatches->setObject(string);
+            string->release();
+        }
+    }
+
+    // skips spaces, then consumes *expected* followed by *separator*
+    static bool token(const char** cursor, const char* expected, char separator) {
+        const char* p = *cursor;
+        while (*p == ' ')
+            p++;
+        while (*expected && *p == *expected) {
+            p++;
+            expected++;
+        }
+        if (*expected || *p != separator)
+            return false;
+        *cursor = p + 1;
+        return true;
+    }
+
+    // a decimal integer, optionally negative, ending at a space or the end of the line
+    static bool number(const char** cursor, SInt64* value) {
+        const char* p = *cursor;
+        bool negative = (*p == '-');
+        if (negative)
+            p++;
+        if (*p < '0' || *p > '9')
+            return false;
+        SInt64 result = 0;
+        while (*p >= '0' && *p <= '9' && result < (1LL << 40))
+            result = result * 10 + (*p++ - '0');
+        if (*p && *p != ' ')
+            return false;
+        *value = negative ? -result : result;
+        *cursor = p;
+        return true;
+    }
+};
+
+#endif /* VoodooPS2OutputRecord_hpp */
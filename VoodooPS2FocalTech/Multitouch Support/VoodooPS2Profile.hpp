@@ -0,0 +1,315 @@
+//
+//  VoodooPS2Profile.hpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#ifndef VoodooPS2Profile_hpp
+#define VoodooPS2Profile_hpp
+
+#include <IOKit/IOLib.h>
+#include <kern/clock.h>
+
+#include "Dependencies/helpers.hpp"
+
+// Cost accounting for the hot paths, compiled in with FOCALTECH_PROFILING
+// (Debug builds). Every stage collects kProfileWindow operations, then
+// publishes ns/op, variance and throughput of that window and starts over,
+// so the published numbers of two builds can be compared directly.
+//
+// Next to wall time a stage can count core clock cycles (IA32_APERF), which
+// keep their meaning when the CPU changes frequency, where ns/op alone would
+// suggest a regression. Reading the counter costs a privileged instruction
+// that traps under most hypervisors, so it is off until the ProfileCycles
+// property turns it on, and CPUs without APERF report no cycles. APERF
+// counts per core, a sample that did not end on the core it started on only
+// contributes its wall time.
+
+#define kProfileWindow      4096
+#define kProfileMaxSample   (1ULL << 24)    // ns, longer samples are clamped
+
+// PROFILE_STOP sets *publish* when the sample completed a window, both
+// expand to nothing otherwise so release builds need none of the state
+#ifdef FOCALTECH_PROFILING
+#define PROFILE_START(var)                      ProfileSample var = ProfileSample::start()
+#define PROFILE_STOP(stage, var, n, publish)    do { if ((stage).record(var, ProfileSample::end(), n)) (publish) = true; } while (0)
+#else
+#define PROFILE_START(var)                      do {} while (0)
+#define PROFILE_STOP(stage, var, n, publish)    do {} while (0)
+#endif
+
+#define kProfileMsrAperf    0xE8
+
+// com.apple.kpi.unsupported, only Info-Debug.plist links it
+extern "C" {
+    int cpu_number(void);
+    void _disable_preemption(void);
+    void _enable_preemption(void);
+}
+
+struct ProfileSample {
+    uint64_t time;      // mach absolute time
+    uint64_t cycles;    // core clock cycles, 0 when not counting
+    int cpu;            // the core *cycles* was read on, -1 when not counting
+
+    static inline bool hasAperf() {
+#if defined(__x86_64__)
+        // CPUID leaf 6, ECX bit 0: APERF/MPERF present, if the CPU has leaf 6
+        static int supported = -1;
+        if (supported < 0) {
+            UInt32 eax = 0, ebx, ecx = 0, edx;
+            asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+            supported = 0;
+            if (eax >= 6) {
+                eax = 6;
+                ecx = 0;
+                asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+                supported = ecx & 1;
+            }
+        }
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    /* Turns cycle counting on or off, it stays off on CPUs without APERF */
+
+    static inline void countCycles(bool enabled) {
+        __atomic_store_n(cycleCounting(), enabled && hasAperf(), __ATOMIC_RELAXED);
+    }
+
+    static inline bool countsCycles() {
+        return __atomic_load_n(cycleCounting(), __ATOMIC_RELAXED);
+    }
+
+    // the counters are read outside the timed interval on both ends, so the
+    // wall time of short stages does not include them
+    static inline ProfileSample start() {
+        ProfileSample sample;
+        readCycles(&sample);
+        sample.time = mach_absolute_time();
+        return sample;
+    }
+
+    static inline ProfileSample end() {
+        ProfileSample sample;
+        sample.time = mach_absolute_time();
+        readCycles(&sample);
+        return sample;
+    }
+
+ private:
+    static inline bool* cycleCounting() {
+        static bool enabled = false;
+        return &enabled;
+    }
+
+    static inline void readCycles(ProfileSample* sample) {
+        sample->cycles = 0;
+        sample->cpu = -1;
+#if defined(__x86_64__)
+        if (countsCycles()) {
+            // read the counter and which core it belongs to without moving in between
+            UInt32 low, high;
+            _disable_preemption();
+            sample->cpu = cpu_number();
+            asm volatile("rdmsr" : "=a"(low), "=d"(high) : "c"(kProfileMsrAperf));
+            _enable_preemption();
+            sample->cycles = ((uint64_t)high << 32) | low;
+        }
+#endif
+    }
+};
+
+class ProfileStage {
+ public:
+    void reset() {
+        count = operations = sum_ns = sum_sq = max_ns = sum_cycles = cycle_operations = 0;
+        min_ns = ~0ULL;
+        window_start = 0;
+        published = false;
+    }
+
+    /* Records one call that handled *ops* operations
+     *
+     * @return *true* when the call completed a window, the caller should publish
+     */
+
+    bool record(const ProfileSample& start, const ProfileSample& end, UInt32 ops) {
+        uint64_t ns;
+        absolutetime_to_nanoseconds(end.time - start.time, &ns);
+        if (ns > kProfileMaxSample)
+            ns = kProfileMaxSample;
+        if (!ops)
+            return false;
+
+        if (!window_start)
+            window_start = start.time;
+        count++;
+        operations += ops;
+        sum_ns += ns;
+        sum_sq += ns * ns;
+        // only cycles read on one core are comparable
+        uint64_t cycles = end.cycles - start.cycles;
+        if (start.cpu >= 0 && start.cpu == end.cpu && end.cycles >= start.cycles) {
+            sum_cycles += cycles;
+            cycle_operations += ops;
+        }
+        if (ns < min_ns)
+            min_ns = ns;
+        if (ns > max_ns)
+            max_ns = ns;
+
+        if (count < kProfileWindow)
+            return false;
+
+        uint64_t elapsed_ns;
+        absolutetime_to_nanoseconds(end.time - window_start, &elapsed_ns);
+        uint64_t mean = sum_ns / count;
+
+        result.ns_per_op = sum_ns / operations;
+        result.cycles_per_op = cycle_operations ? sum_cycles / cycle_operations : 0;
+        result.variance = sum_sq / count - mean * mean;
+        result.ops_per_sec = elapsed_ns ? operations * 1000000000ULL / elapsed_ns : 0;
+        result.min_ns = min_ns;
+        result.max_ns = max_ns;
+        result.operations = operations;
+
+        uint64_t windows = result.windows + 1;
+        reset();
+        result.windows = windows;
+        published = true;
+        return true;
+    }
+
+    /* Adds the last completed window to *dict* under *name*, nothing before the first window completed */
+
+    void serialize(OSDictionary* dict, const char* name) const {
+        if (!published)
+            return;
+
+        OSDictionary* stage = OSDictionary::withCapacity(8);
+        if (!stage)
+            return;
+
+        setOSDictionaryNumber64(stage, "NsPerOp", result.ns_per_op);
+        setOSDictionaryNumber64(stage, "CyclesPerOp", result.cycles_per_op);
+        setOSDictionaryNumber64(stage, "Variance", result.variance);
+        setOSDictionaryNumber64(stage, "OpsPerSec", result.ops_per_sec);
+        setOSDictionaryNumber64(stage, "MinNs", result.min_ns);
+        setOSDictionaryNumber64(stage, "MaxNs", result.max_ns);
+        setOSDictionaryNumber64(stage, "Operations", result.operations);
+        setOSDictionaryNumber64(stage, "Windows", result.windows);
+        dict->setObject(name, stage);
+        stage->release();
+    }
+
+ private:
+    // current window, per call
+    uint64_t count;
+    uint64_t operations;
+    uint64_t sum_ns;
+    uint64_t sum_sq;
+    uint64_t min_ns;
+    uint64_t max_ns;
+    uint64_t sum_cycles;
+    uint64_t cycle_operations;
+    uint64_t window_start;
+    bool published;
+
+    // last completed window
+    struct {
+        uint64_t ns_per_op;
+        uint64_t cycles_per_op; // core clock cycles
+        uint64_t variance;      // ns^2, per call
+        uint64_t ops_per_sec;
+        uint64_t min_ns;
+        uint64_t max_ns;
+        uint64_t operations;
+        uint64_t windows;
+    } result = {};
+};
+
+// Latency distribution with logarithmic buckets: bucket 0 holds samples
+// below kLatencyBucketBase, bucket n samples below kLatencyBucketBase << n,
+// the last bucket everything above.
+
+#define kLatencyBuckets     16
+#define kLatencyBucketBase  16      // us
+
+class LatencyHistogram {
+ public:
+    void reset() {
+        for (int i = 0; i < kLatencyBuckets; i++)
+            buckets[i] = 0;
+        count = sum_us = max_us = 0;
+    }
+
+    /* Records the time between two mach absolute times */
+
+    void record(uint64_t from, uint64_t to) {
+        uint64_t ns;
+        absolutetime_to_nanoseconds(to > from ? to - from : 0, &ns);
+        uint64_t us = ns / 1000;
+
+        int bucket = 0;
+        if (us >= kLatencyBucketBase) {
+            bucket = 64 - __builtin_clzll(us / kLatencyBucketBase);
+            if (bucket >= kLatencyBuckets)
+                bucket = kLatencyBuckets - 1;
+        }
+
+        buckets[bucket]++;
+        count++;
+        sum_us += us;
+        if (us > max_us)
+            max_us = us;
+    }
+
+    /* Adds the distribution to *dict* under *name*, percentiles are bucket upper bounds in us */
+
+    void serialize(OSDictionary* dict, const char* name) const {
+        if (!count)
+            return;
+
+        OSDictionary* histogram = OSDictionary::withCapacity(7);
+        OSArray* counts = OSArray::withCapacity(kLatencyBuckets);
+        if (histogram && counts) {
+            for (int i = 0; i < kLatencyBuckets; i++) {
+                if (OSNumber* number = OSNumber::withNumber(buckets[i], 64)) {
+                    counts->setObject(number);
+                    number->release();
+                }
+            }
+            histogram->setObject("Buckets", counts);
+            setOSDictionaryNumber64(histogram, "Samples", count);
+            setOSDictionaryNumber64(histogram, "MeanUs", sum_us / count);
+            setOSDictionaryNumber64(histogram, "P50Us", percentile(50));
+            setOSDictionaryNumber64(histogram, "P99Us", percentile(99));
+            setOSDictionaryNumber64(histogram, "MaxUs", max_us);
+            dict->setObject(name, histogram);
+        }
+        OSSafeReleaseNULL(counts);
+        OSSafeReleaseNULL(histogram);
+    }
+
+ private:
+    uint64_t buckets[kLatencyBuckets];
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+
+    uint64_t percentile(int p) const {
+        uint64_t seen = 0, wanted = (count * p + 99) / 100;
+        for (int i = 0; i < kLatencyBuckets - 1; i++) {
+            seen += buckets[i];
+            if (seen >= wanted)
+                return (uint64_t)kLatencyBucketBase << i;
+        }
+        return max_us;
+    }
+};
+
+#endif /* VoodooPS2Profile_hpp */
@@ -25,9 +25,11 @@
 #include <IOKit/IOLib.h>
 #include <IOKit/IOWorkLoop.h>
 #include <IOKit/hidsystem/IOHIDParameter.h>
+#include <libkern/OSByteOrder.h>
 #include "VoodooPS2Controller/VoodooPS2Controller.h"
 #include "VoodooPS2FocalTech.hpp"
 #include "Multitouch Support/VoodooPS2DigitiserTransducer.hpp"
+#include "Multitouch Support/Dependencies/helpers.hpp"
 
 // =============================================================================
 // ApplePS2FocalTechTouchPad Class Implementation
@@ -53,15 +55,20 @@ bool ApplePS2FocalTechTouchPad::init(OSDictionary * dict)
     if (!super::init(dict))
         return false;
     
-    transducers = OSArray::withCapacity(FOCALTECH_MAX_FINGERS);
-    if (!transducers) {
-        return false;
-    }
     DigitiserTransducerType type = kDigitiserTransducerFinger;
-    for (int i = 0; i < FOCALTECH_MAX_FINGERS; i++) {
-        VoodooPS2DigitiserTransducer* transducer = VoodooPS2DigitiserTransducer::transducer(type, NULL);
-        transducers->setObject(transducer);
-        transducer->release();
+    for (int set = 0; set < kFrameQueueSlots; set++) {
+        transducers[set] = OSArray::withCapacity(FOCALTECH_MAX_FINGERS);
+        if (!transducers[set]) {
+            return false;
+        }
+        for (int i = 0; i < FOCALTECH_MAX_FINGERS; i++) {
+            VoodooPS2DigitiserTransducer* transducer = VoodooPS2DigitiserTransducer::transducer(type);
+            if (!transducer) {
+                return false;
+            }
+            transducers[set]->setObject(transducer);
+            transducer->release();
+        }
     }
     
     // initialize state...
@@ -71,7 +78,56 @@ bool ApplePS2FocalTechTouchPad::init(OSDictionary * dict)
     _isReadNext                = false;
     _fingerCount               = 0;
     keytime                    = 0;
-    maxaftertyping             = 0;
+    lastbuttontime             = 0;
+    _lastButtons               = 0;
+    _debouncedButtons          = 0;
+    _engineButtons             = 0;
+    _idleFrameSent             = false;
+    _idleFrameButtons          = 0;
+    _relativeContacts          = 0;
+    _relativeRemainderX        = 0;
+    _relativeRemainderY        = 0;
+    _frameHead                 = 0;
+    _frameTail                 = 0;
+    _engineWorkLoop            = 0;
+    _engineSource              = 0;
+    _resetCall                 = 0;
+    _stopping                  = false;
+    _resetState                = kResetIdle;
+    _resetLevel                = 0;
+    _watchdogTimer             = 0;
+    _watchdogLevel             = 0;
+    _watchdogRejected          = 0;
+    _watchdogFaultStart        = 0;
+    _watchdogLastReset         = 0;
+    _lastPacketTime            = 0;
+    _parseArrival              = 0;
+    bzero(_packetArrival, sizeof(_packetArrival));
+    _lastChangeTime            = 0;
+    _contactsActive            = false;
+    _packetInconsistent        = false;
+    _configs[0].quiet_time         = 0;
+    _configs[0].button_debounce    = 0;
+    _configs[0].overflow_policy    = kOverflowDropNewest;
+    _configs[0].pointer_divisor    = kRelativePointerDivisor;
+    _configs[0].scroll_divisor     = kRelativeScrollDivisor;
+    _configs[0].watchdog           = true;
+    _configs[1]                    = _configs[0];
+    _configGeneration          = 0;
+#ifdef FOCALTECH_PROFILING
+    for (int i = 0; i < kProfileStages; i++)
+        _profile[i].reset();
+    for (int i = 0; i < kLatencyPhases; i++)
+        _latency[i].reset();
+    bzero(_latencyArrival, sizeof(_latencyArrival));
+    _parseLatencyArrival       = 0;
+    _profilePending            = false;
+#endif
+    _configWriter              = 0;
+    _ringLock                  = 0;
+    _realignPending            = false;
+    bzero(&_stats, sizeof(_stats));
+    bzero(&_publishedStats, sizeof(_publishedStats));
     
     return true;
 }
@@ -85,10 +141,9 @@ ApplePS2FocalTechTouchPad* ApplePS2FocalTechTouchPad::probe(IOService * provider
     if (!super::probe(provider, score))
         return 0;
     
-    //  Read QuietTimeAfterTyping configuration value
-    OSNumber* quiet_time_after_typing = OSDynamicCast(OSNumber, getProperty("QuietTimeAfterTyping"));
-    if(quiet_time_after_typing != NULL)
-        maxaftertyping = quiet_time_after_typing->unsigned64BitValue() * 1000000;
+    //  Read the configuration from Info.plist, setProperties replaces it later
+    if (parseConfig(getPropertyTable(), &_configs[0]) != kIOReturnSuccess)
+        IOLog("%s :: invalid configuration in Info.plist, using defaults\n", getName());
     
     //
     // The driver has been instructed to verify the presence of the actual
@@ -128,6 +183,37 @@ bool ApplePS2FocalTechTouchPad::start(IOService * provider)
     if (!super::start(provider))
         return false;
     
+    //
+    // The multitouch engines run on their own work loop, fed by packetReady.
+    //
+    
+    _engineWorkLoop = IOWorkLoop::workLoop();
+    _engineSource = IOInterruptEventSource::interruptEventSource(this, OSMemberFunctionCast(IOInterruptEventSource::Action, this, &ApplePS2FocalTechTouchPad::drainFrameQueue));
+    if (!_engineWorkLoop || !_engineSource || _engineWorkLoop->addEventSource(_engineSource) != kIOReturnSuccess) {
+        IOLog("%s :: Failed to set up the engine work loop\n", getName());
+        OSSafeReleaseNULL(_engineSource);
+        OSSafeReleaseNULL(_engineWorkLoop);
+        super::stop(provider);
+        return false;
+    }
+    
+    _resetCall = thread_call_allocate(ApplePS2FocalTechTouchPad::resetCallout, this);
+    _ringLock = IOSimpleLockAlloc();
+    if (!_resetCall || !_ringLock) {
+        IOLog("%s :: Failed to allocate the reset thread call or the ring lock\n", getName());
+        if (_resetCall)
+            thread_call_free(_resetCall);
+        _resetCall = 0;
+        if (_ringLock)
+            IOSimpleLockFree(_ringLock);
+        _ringLock = 0;
+        _engineWorkLoop->removeEventSource(_engineSource);
+        OSSafeReleaseNULL(_engineSource);
+        OSSafeReleaseNULL(_engineWorkLoop);
+        super::stop(provider);
+        return false;
+    }
+    
     //
     // Maintain a pointer to and retain the provider object.
     //
@@ -186,6 +272,17 @@ bool ApplePS2FocalTechTouchPad::start(IOService * provider)
     
     _powerControlHandlerInstalled = true;
     
+    //
+    // Watch the packet stream and recover from desyncs in the background, the
+    // same timer publishes the statistics.
+    //
+    
+    _watchdogTimer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &ApplePS2FocalTechTouchPad::watchdogTick));
+    if (_watchdogTimer && getWorkLoop() && getWorkLoop()->addEventSource(_watchdogTimer) == kIOReturnSuccess)
+        _watchdogTimer->setTimeoutMS(kWatchdogInterval);
+    else
+        OSSafeReleaseNULL(_watchdogTimer);
+    
     if(mt_interface) {
         mt_interface->registerService();
     }
@@ -225,6 +322,37 @@ void ApplePS2FocalTechTouchPad::stop( IOService * provider )
     if ( _powerControlHandlerInstalled ) _device->uninstallPowerControlAction();
     _powerControlHandlerInstalled = false;
     
+    //
+    // Stop the watchdog, then wait for a reset in progress, it uses the device.
+    //
+    
+    if (_watchdogTimer) {
+        _watchdogTimer->cancelTimeout();
+        getWorkLoop()->removeEventSource(_watchdogTimer);
+        OSSafeReleaseNULL(_watchdogTimer);
+    }
+    
+    // No new resets from here on. A keyboard notification may still be in
+    // requestReset, the thread call is only freed along with the driver
+    __atomic_store_n(&_stopping, true, __ATOMIC_RELEASE);
+    if (_resetCall)
+        thread_call_cancel_wait(_resetCall);
+    
+    if (_ringLock) {
+        IOSimpleLockFree(_ringLock);
+        _ringLock = 0;
+    }
+    
+    //
+    // No more frames are queued, stop the engine work loop's consumer.
+    //
+    
+    if (_engineSource) {
+        _engineSource->disable();
+        _engineWorkLoop->removeEventSource(_engineSource);
+        OSSafeReleaseNULL(_engineSource);
+    }
+    
     //
     // Release the pointer to the provider object.
     //
@@ -232,9 +360,10 @@ void ApplePS2FocalTechTouchPad::stop( IOService * provider )
     OSSafeReleaseNULL(_device);
     
     unpublish_multitouch_interface();
+    OSSafeReleaseNULL(_engineWorkLoop);
     
-    if (transducers){
-        OSSafeReleaseNULL(transducers);
+    for (int set = 0; set < kFrameQueueSlots; set++) {
+        OSSafeReleaseNULL(transducers[set]);
     }
     
     super::stop(provider);
@@ -242,6 +371,19 @@ void ApplePS2FocalTechTouchPad::stop( IOService * provider )
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
+void ApplePS2FocalTechTouchPad::free()
+{
+    if (_resetCall) {
+        thread_call_cancel_wait(_resetCall);
+        thread_call_free(_resetCall);
+        _resetCall = 0;
+    }
+    
+    super::free();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
 bool ApplePS2FocalTechTouchPad::publish_multitouch_interface() {
     mt_interface = new VoodooPS2MultitouchInterface();
     if (!mt_interface) {
@@ -290,6 +432,8 @@ bool ApplePS2FocalTechTouchPad::init_multitouch_interface() {
         mt_interface->physical_max_y = PHYSCICAL_MAX_Y;
         mt_interface->logical_max_x  = LOGICAL_MAX_X;
         mt_interface->logical_max_y  = LOGICAL_MAX_Y;
+        mt_interface->setEngineWorkLoop(_engineWorkLoop);
+        mt_interface->setClock(&_clock);
     }
     return true;
 }
@@ -297,6 +441,41 @@ bool ApplePS2FocalTechTouchPad::init_multitouch_interface() {
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 PS2InterruptResult ApplePS2FocalTechTouchPad::interruptOccurred(UInt8 data)
+{
+#ifdef FOCALTECH_PROFILING
+    // A replay owns the framing state and the ring buffer, device bytes are
+    // dropped until it is over. Announcing the byte before looking at the
+    // flag pairs with replayTrace, which sets the flag and then waits for
+    // the byte in flight: one of the two always sees the other.
+    __atomic_store_n(&_liveByte, true, __ATOMIC_SEQ_CST);
+    if (mt_interface && __atomic_load_n(&mt_interface->replaying, __ATOMIC_SEQ_CST))
+    {
+        __atomic_store_n(&_liveByte, false, __ATOMIC_RELEASE);
+        return kPS2IR_packetBuffering;
+    }
+    PS2InterruptResult result = timedReceiveByte(data);
+    __atomic_store_n(&_liveByte, false, __ATOMIC_RELEASE);
+    return result;
+#else
+    return receiveByte(data);
+#endif
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#ifdef FOCALTECH_PROFILING
+PS2InterruptResult ApplePS2FocalTechTouchPad::timedReceiveByte(UInt8 data)
+{
+    PROFILE_START(start);
+    PS2InterruptResult result = receiveByte(data);
+    PROFILE_STOP(_profile[kProfileInterruptByte], start, 1, _profilePending);
+    return result;
+}
+#endif
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+PS2InterruptResult ApplePS2FocalTechTouchPad::receiveByte(UInt8 data)
 {
     //
     // This will be invoked automatically from our device when asynchronous
@@ -307,25 +486,74 @@ PS2InterruptResult ApplePS2FocalTechTouchPad::interruptOccurred(UInt8 data)
     // packets may get out of sequence and things will get very confusing.
     //
     
+    // a realign asked to drop the partial packet, see realignStream
+    if (__builtin_expect(__atomic_load_n(&_realignPending, __ATOMIC_ACQUIRE), false))
+    {
+        _realignPending = false;
+        _packetByteCount = 0;
+        _isReadNext = false;
+    }
+    
     if (0 == _packetByteCount && (data & 0xc8) != 0x08 && (data & 0xf8) != 0xf8)
     {
+        OSIncrementAtomic64((volatile SInt64*)&_stats.rejected_bytes);
         IOLog("%s :: Unexpected byte0 data (%02x) from PS/2 controller\n", getName(), data);
         return kPS2IR_packetBuffering;
     }
     
+    if (0 == _packetByteCount)
+        _isReadNext = false;
+    
+    // frames are stamped with the arrival of their first byte
     UInt8* packet = _ringBuffer.head();
+    if (0 == _packetByteCount)
+    {
+        AbsoluteTime arrival = _clock.now();
+        _packetArrival[FOCALTECH_RING_SLOT(packet)] = arrival;
+#ifdef FOCALTECH_PROFILING
+        _latencyArrival[FOCALTECH_RING_SLOT(packet)] = _clock.isVirtual() ? mach_absolute_time() : arrival;
+#endif
+    }
     packet[_packetByteCount++] = data;
     
     if (5 == _packetByteCount)
-        _fingerCount = (int)(data & 3) + ((data & 48) >> 2);
+        _fingerCount = FOCALTECH_FINGER_COUNT(data);
     
     if (kPacketLengthLarge == _packetByteCount || kPacketLengthSmall == _packetByteCount)
     {
-        // complete 16 or 8-byte packet received...
+        // complete 16 or 8-byte packet received... at 16 bytes the packet
+        // always completes, so writes never leave the ring buffer slot
         if (_fingerCount > 2 && _isReadNext == false){
             _isReadNext = true;
             return kPS2IR_packetBuffering;
         }
+        // RingBuffer::advanceHead silently refuses to move into the tail,
+        // either drop the oldest queued packet to make room or account for
+        // the packet we are about to lose
+        if (_ringBuffer.count() >= kPacketLengthMax * (kPacketRingSlots - 1))
+        {
+            focaltech_config config;
+            readConfig(&config);
+            if (config.overflow_policy == kOverflowDropOldest)
+            {
+                // packetReady takes packets out under the same lock, it may
+                // have made room in the meantime
+                IOInterruptState state = IOSimpleLockLockDisableInterrupt(_ringLock);
+                if (_ringBuffer.count() >= kPacketLengthMax * (kPacketRingSlots - 1))
+                {
+                    UInt8* oldest = _ringBuffer.tail();
+                    OSIncrementAtomic((volatile SInt32*)&_stats.ring_overflows);
+                    OSAddAtomic64(FOCALTECH_FINGER_COUNT(oldest[4]) > 2 ? kPacketLengthLarge : kPacketLengthSmall, (volatile SInt64*)&_stats.lost_bytes);
+                    _ringBuffer.advanceTail(kPacketLengthMax);
+                }
+                IOSimpleLockUnlockEnableInterrupt(_ringLock, state);
+            }
+            else
+            {
+                OSIncrementAtomic((volatile SInt32*)&_stats.ring_overflows);
+                OSAddAtomic64(_packetByteCount, (volatile SInt64*)&_stats.lost_bytes);
+            }
+        }
         _ringBuffer.advanceHead(kPacketLengthMax);
         _isReadNext = false;
         _packetByteCount = 0;
@@ -336,102 +564,801 @@ PS2InterruptResult ApplePS2FocalTechTouchPad::interruptOccurred(UInt8 data)
 
 void ApplePS2FocalTechTouchPad::packetReady()
 {
+    PROFILE_START(ready_start);
+    UInt32 queued = _ringBuffer.count() / kPacketLengthMax;
+    
+    if (queued > _stats.ring_high_water)
+        _stats.ring_high_water = queued;
+    
     // empty the ring buffer, dispatching each packet...
     while (_ringBuffer.count() >= kPacketLengthMax)
     {
-        UInt8* packet = _ringBuffer.tail();
-        // now we have complete packet
-        parsePacket(packet);
+        // now we have complete packet, take it out of the ring before
+        // receiveByte can drop it to make room
+        UInt8 packet[kPacketLengthMax];
+        IOInterruptState state = IOSimpleLockLockDisableInterrupt(_ringLock);
+        UInt8* slot = _ringBuffer.tail();
+        memcpy(packet, slot, kPacketLengthMax);
+        _parseArrival = _packetArrival[FOCALTECH_RING_SLOT(slot)];
+#ifdef FOCALTECH_PROFILING
+        _parseLatencyArrival = _latencyArrival[FOCALTECH_RING_SLOT(slot)];
+#endif
         _ringBuffer.advanceTail(kPacketLengthMax);
+        IOSimpleLockUnlockEnableInterrupt(_ringLock, state);
+        
+        PROFILE_START(parse_start);
+#ifdef FOCALTECH_PROFILING
+        _latency[kLatencyDeferral].record(_parseLatencyArrival, parse_start.time);
+#endif
+        parsePacket(packet);
+        PROFILE_STOP(_profile[FOCALTECH_FINGER_COUNT(packet[4]) > 2 ? kProfileParseFourFingers : kProfileParseTwoFingers], parse_start, 1, _profilePending);
+    }
+    
+    // hand everything decoded in this pass to the engine work loop at once
+    if (_engineSource && _frameHead != __atomic_load_n(&_frameTail, __ATOMIC_ACQUIRE))
+        _engineSource->interruptOccurred(0, 0, 0);
+    
+    PROFILE_STOP(_profile[kProfilePacketReady], ready_start, queued, _profilePending);
+#ifdef FOCALTECH_PROFILING
+    if (_profilePending) {
+        _profilePending = false;
+        publishProfile();
     }
+#endif
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+#ifdef FOCALTECH_PROFILING
+void ApplePS2FocalTechTouchPad::publishProfile() {
+    static const char* const names[kProfileStages] = {"InterruptByte", "PacketReady", "ParsePacket2", "ParsePacket4", "SendTouchData"};
+    static const char* const phases[kLatencyPhases] = {"LatencyDeferral", "LatencyQueue", "LatencyDispatch", "LatencyTotal"};
+    
+    OSDictionary* dict = OSDictionary::withCapacity(kProfileStages + kLatencyPhases);
+    if (!dict)
+        return;
+    
+    for (int i = 0; i < kProfileStages; i++)
+        _profile[i].serialize(dict, names[i]);
+    
+    // filled in on the engine work loop, a sample or two behind is fine here
+    for (int i = 0; i < kLatencyPhases; i++)
+        _latency[i].serialize(dict, phases[i]);
+    
+    setProperty("Profile", dict);
+    dict->release();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void ApplePS2FocalTechTouchPad::recordPointer(int dx, int dy, UInt32 buttons) {
+    if (!mt_interface)
+        return;
+    mt_interface->output_record.event(kOutputPointer);
+    mt_interface->output_record.field(kFieldDeltaX, dx);
+    mt_interface->output_record.field(kFieldDeltaY, dy);
+    mt_interface->output_record.field(kFieldButtons, buttons);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void ApplePS2FocalTechTouchPad::recordScroll(int vertical, int horizontal) {
+    if (!mt_interface)
+        return;
+    mt_interface->output_record.event(kOutputScroll);
+    mt_interface->output_record.field(kFieldVertical, vertical);
+    mt_interface->output_record.field(kFieldHorizontal, horizontal);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+IOReturn ApplePS2FocalTechTouchPad::replayTrace(OSData* trace, const focaltech_replay_check* check) {
+    //
+    // Feeds a recorded trace through the same path as device bytes, on
+    // virtual time advanced by its delays, and publishes every event the
+    // pipeline emitted on the multitouch interface, checked against the
+    // expected output when one was given. Nothing the replay produces
+    // reaches the system, and the driver and engines start from and return
+    // to a clean state.
+    //
+    
+    const UInt8* bytes = (const UInt8*)trace->getBytesNoCopy();
+    unsigned length = trace->getLength();
+    
+    if (!mt_interface || !_engineWorkLoop)
+        return kIOReturnNotReady;
+    
+    // reject malformed traces before anything is fed
+    uint64_t total_ns = (uint64_t)kReplaySettleTime * 1000;
+    for (unsigned offset = 0; offset < length; ) {
+        if (length - offset < kReplayRecordHeader)
+            return kIOReturnBadArgument;
+        UInt32 delay = OSReadLittleInt32(bytes, offset);
+        UInt8 packet_length = bytes[offset + 4];
+        if (delay > kReplayMaxDelay || packet_length == 0 || packet_length > kPacketLengthMax || length - offset - kReplayRecordHeader < packet_length)
+            return kIOReturnBadArgument;
+        total_ns += (uint64_t)delay * 1000;
+        offset += kReplayRecordHeader + packet_length;
+    }
+    
+    // start from a clean pipeline and recording, far enough in the past that
+    // virtual time ends before the mach time the clock returns to
+    bool idle = false;
+    if (!__atomic_compare_exchange_n(&mt_interface->replaying, &idle, true, false, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE))
+        return kIOReturnBusy;
+    // from here on interruptOccurred drops device bytes, let the one it may
+    // be handling finish before the framing state is reset
+    while (__atomic_load_n(&_liveByte, __ATOMIC_SEQ_CST))
+        IODelay(1);
+    _engineWorkLoop->runAction(OSMemberFunctionCast(IOWorkLoop::Action, this, &ApplePS2FocalTechTouchPad::replayDrain), this, (void*)kReplayStep);
+    getWorkLoop()->runAction(OSMemberFunctionCast(IOWorkLoop::Action, this, &ApplePS2FocalTechTouchPad::replayReset), this);
+    if (_engineWorkLoop->runAction(OSMemberFunctionCast(IOWorkLoop::Action, this, &ApplePS2FocalTechTouchPad::replayDrain), this, (void*)kReplayStart) != kIOReturnSuccess) {
+        __atomic_store_n(&mt_interface->replaying, false, __ATOMIC_RELEASE);
+        return kIOReturnNoMemory;
+    }
+    AbsoluteTime now = _clock.now(), span = _clock.toTicks(total_ns);
+    _clock.useVirtualTime(now > span ? now - span : 0);
+    
+    for (unsigned offset = 0; offset < length; ) {
+        UInt32 delay = OSReadLittleInt32(bytes, offset);
+        UInt8 packet_length = bytes[offset + 4];
+        
+        // timers due before the packet fire first, its frames are delivered before time moves on
+        _clock.advance((uint64_t)delay * 1000);
+        _engineWorkLoop->runAction(OSMemberFunctionCast(IOWorkLoop::Action, this, &ApplePS2FocalTechTouchPad::replayTimers), this);
+        getWorkLoop()->runAction(OSMemberFunctionCast(IOWorkLoop::Action, this, &ApplePS2FocalTechTouchPad::replayPacket), this, (void*)(bytes + offset + kReplayRecordHeader), (void*)(uintptr_t)packet_length);
+        _engineWorkLoop->runAction(OSMemberFunctionCast(IOWorkLoop::Action, this, &ApplePS2FocalTechTouchPad::replayDrain), this, (void*)kReplayStep);
+        offset += kReplayRecordHeader + packet_length;
+    }
+    
+    _clock.advance((uint64_t)kReplaySettleTime * 1000);
+    _engineWorkLoop->runAction(OSMemberFunctionCast(IOWorkLoop::Action, this, &ApplePS2FocalTechTouchPad::replayTimers), this);
+    _engineWorkLoop->runAction(OSMemberFunctionCast(IOWorkLoop::Action, this, &ApplePS2FocalTechTouchPad::replayDrain), this, (void*)kReplayFinish, (void*)check);
+    _clock.useMachTime();
+    getWorkLoop()->runAction(OSMemberFunctionCast(IOWorkLoop::Action, this, &ApplePS2FocalTechTouchPad::replayReset), this);
+    __atomic_store_n(&mt_interface->replaying, false, __ATOMIC_RELEASE);
+    return kIOReturnSuccess;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+IOReturn ApplePS2FocalTechTouchPad::replayGestures(OSObject* gestures, const focaltech_replay_check* check) {
+    //
+    // Renders one gesture dictionary, or an array of them played one after
+    // the other, into a trace and replays it, see FocalTechGestureGenerator.
+    //
+    
+    OSArray* list = OSDynamicCast(OSArray, gestures);
+    unsigned count = list ? list->getCount() : 1;
+    if (count == 0 || count > kReplayMaxGestures)
+        return kIOReturnBadArgument;
+    
+    FocalTechGesture script[kReplayMaxGestures];
+    size_t length = 0;
+    for (unsigned i = 0; i < count; i++) {
+        OSDictionary* dict = OSDynamicCast(OSDictionary, list ? list->getObject(i) : gestures);
+        if (!dict || parseGesture(dict, &script[i]) != kIOReturnSuccess)
+            return kIOReturnBadArgument;
+        length += FocalTechGestureGenerator::traceLength(script[i]);
+    }
+    
+    UInt8* buffer = (UInt8*)IOMalloc(length);
+    if (!buffer)
+        return kIOReturnNoMemory;
+    
+    FocalTechGestureGenerator generator(buffer, length);
+    for (unsigned i = 0; i < count; i++)
+        generator.add(script[i]);
+    
+    IOReturn result = kIOReturnNoMemory;
+    if (OSData* trace = OSData::withBytesNoCopy(buffer, (unsigned)generator.length())) {
+        result = replayTrace(trace, check);
+        trace->release();
+    }
+    IOFree(buffer, length);
+    return result;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+IOReturn ApplePS2FocalTechTouchPad::parseGesture(OSDictionary* dict, FocalTechGesture* gesture) {
+    static const char* const kinds[] = {"Swipe", "Pinch", "Rotate", "Tap", "Drag"};
+    static const struct { const char* key; int FocalTechGesture::* field; } signed_keys[] = {
+        {"Fingers", &FocalTechGesture::fingers}, {"CenterX", &FocalTechGesture::center_x},
+        {"CenterY", &FocalTechGesture::center_y}, {"DeltaX", &FocalTechGesture::delta_x},
+        {"DeltaY", &FocalTechGesture::delta_y}, {"Radius", &FocalTechGesture::radius},
+        {"RadiusEnd", &FocalTechGesture::radius_end}, {"Rotation", &FocalTechGesture::rotation},
+        {"Noise", &FocalTechGesture::noise}
+    };
+    static const struct { const char* key; UInt32 FocalTechGesture::* field; } unsigned_keys[] = {
+        {"Duration", &FocalTechGesture::duration}, {"Rate", &FocalTechGesture::rate},
+        {"Seed", &FocalTechGesture::seed}, {"Pause", &FocalTechGesture::pause}
+    };
+    
+    FocalTechGesture next;
+    OSString* kind = OSDynamicCast(OSString, dict->getObject("Gesture"));
+    unsigned k = 0;
+    while (kind && k < sizeof(kinds) / sizeof(kinds[0]) && !kind->isEqualTo(kinds[k]))
+        k++;
+    if (!kind || k == sizeof(kinds) / sizeof(kinds[0]))
+        return kIOReturnBadArgument;
+    next.kind = (FocalTechGestureKind)k;
+    
+    // integers written from user space arrive as 64-bit two's complement
+    for (unsigned i = 0; i < sizeof(signed_keys) / sizeof(signed_keys[0]); i++) {
+        OSObject* value = dict->getObject(signed_keys[i].key);
+        if (!value)
+            continue;
+        OSNumber* number = OSDynamicCast(OSNumber, value);
+        SInt64 field = number ? (SInt64)number->unsigned64BitValue() : 0;
+        if (!number || field < -LOGICAL_MAX_X * 16 || field > LOGICAL_MAX_X * 16)
+            return kIOReturnBadArgument;
+        next.*signed_keys[i].field = (int)field;
+    }
+    for (unsigned i = 0; i < sizeof(unsigned_keys) / sizeof(unsigned_keys[0]); i++) {
+        OSObject* value = dict->getObject(unsigned_keys[i].key);
+        if (!value)
+            continue;
+        OSNumber* number = OSDynamicCast(OSNumber, value);
+        if (!number || number->unsigned64BitValue() > UINT32_MAX)
+            return kIOReturnBadArgument;
+        next.*unsigned_keys[i].field = number->unsigned32BitValue();
+    }
+    
+    if (!FocalTechGestureGenerator::isValid(next))
+        return kIOReturnBadArgument;
+    *gesture = next;
+    return kIOReturnSuccess;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+IOReturn ApplePS2FocalTechTouchPad::parseReplayCheck(OSDictionary* dict, focaltech_replay_check* check) {
+    //
+    // The optional expected output of a replay (an array of event lines,
+    // see OutputRecord) and the tolerances it is compared with.
+    //
+    
+    static const struct { const char* key; VoodooPS2OutputTolerance tolerance; } keys[] = {
+        {"Coordinate", kToleranceCoordinate}, {"Delta", kToleranceDelta}
+    };
+    
+    memset(check, 0, sizeof(*check));
+    if (OSObject* expected = dict->getObject("ReplayExpected")) {
+        check->expected = OSDynamicCast(OSArray, expected);
+        if (!check->expected)
+            return kIOReturnBadArgument;
+        for (unsigned i = 0; i < check->expected->getCount(); i++)
+            if (!OSDynamicCast(OSString, check->expected->getObject(i)))
+                return kIOReturnBadArgument;
+    }
+    
+    OSObject* value = dict->getObject("ReplayTolerance");
+    OSDictionary* tolerance = OSDynamicCast(OSDictionary, value);
+    if (value && !tolerance)
+        return kIOReturnBadArgument;
+    for (unsigned i = 0; tolerance && i < sizeof(keys) / sizeof(keys[0]); i++) {
+        OSObject* entry = tolerance->getObject(keys[i].key);
+        if (!entry)
+            continue;
+        OSNumber* number = OSDynamicCast(OSNumber, entry);
+        if (!number || number->unsigned64BitValue() > LOGICAL_MAX_X)
+            return kIOReturnBadArgument;
+        check->tolerance[keys[i].tolerance] = number->unsigned32BitValue();
+    }
+    return kIOReturnSuccess;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+IOReturn ApplePS2FocalTechTouchPad::replayPacket(void* bytes, void* length, void* unused1, void* unused2) {
+    // on the PS/2 work loop, as the controller delivers device bytes, which
+    // interruptOccurred drops meanwhile
+    for (uintptr_t i = 0; i < (uintptr_t)length; i++)
+        if (timedReceiveByte(((UInt8*)bytes)[i]) == kPS2IR_packetReady)
+            packetReady();
+    return kIOReturnSuccess;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+IOReturn ApplePS2FocalTechTouchPad::replayDrain(void* phase, void* check, void* unused2, void* unused3) {
+    // on the engine work loop: deliver what the engine source has not picked
+    // up yet, then publish the finished recording or start a new one once
+    // the engines are reset
+    drainFrameQueue(_engineSource, 0);
+    if ((uintptr_t)phase == kReplayStep)
+        return kIOReturnSuccess;
+    
+    if ((uintptr_t)phase == kReplayFinish)
+        mt_interface->publishOutput(((const focaltech_replay_check*)check)->expected, ((const focaltech_replay_check*)check)->tolerance);
+    
+    // the engines and what drainFrameQueue keeps between frames
+    mt_interface->resetState();
+    _lastButtons = 0;
+    _engineButtons = 0;
+    _relativeContacts = 0;
+    _relativeRemainderX = 0;
+    _relativeRemainderY = 0;
+    
+    if ((uintptr_t)phase == kReplayStart && !mt_interface->output_record.start())
+        return kIOReturnNoMemory;
+    return kIOReturnSuccess;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+IOReturn ApplePS2FocalTechTouchPad::replayReset(void* unused0, void* unused1, void* unused2, void* unused3) {
+    // on the PS/2 work loop: drop the queued bytes and everything parsing
+    // carries from one packet to the next
+    realignStream((void*)kResetFull, 0, 0, 0);
+    _lastPacketTime = _lastChangeTime;
+    _packetInconsistent = false;
+    _debouncedButtons = 0;
+    _idleFrameButtons = 0;
+    lastbuttontime = 0;
+    keytime = 0;
+    left = right = 0;
+    memset(_lastDeviceData, 0, sizeof(_lastDeviceData));
+    for (int i = 0; i < FOCALTECH_MAX_FINGERS; i++)
+        fingerStates[i].valid = false;
+    
+    // the next frame chains from the transducers of the last queued one,
+    // once the engines are done with them
+    if (_frameHead != __atomic_load_n(&_frameTail, __ATOMIC_ACQUIRE))
+        return kIOReturnSuccess;
+    OSArray* previous = transducers[(_frameHead - 1) % kFrameQueueSlots];
+    for (int i = 0; i < FOCALTECH_MAX_FINGERS; i++) {
+        VoodooPS2DigitiserTransducer* transducer = OSDynamicCast(VoodooPS2DigitiserTransducer, previous->getObject(i));
+        if (!transducer)
+            continue;
+        transducer->coordinates = {};
+        transducer->tip_switch = {};
+        transducer->physical_button = {};
+        transducer->is_valid = false;
+        transducer->timestamp = transducer->last_timestamp = 0;
+    }
+    return kIOReturnSuccess;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+IOReturn ApplePS2FocalTechTouchPad::replayTimers(void* unused0, void* unused1, void* unused2, void* unused3) {
+    // on the engine work loop, where the engine timers would have fired
+    mt_interface->advanceTime(_clock.now());
+    return kIOReturnSuccess;
+}
+#endif
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+IOReturn ApplePS2FocalTechTouchPad::parseConfig(OSDictionary* dict, focaltech_config* config) {
+    //
+    // Applies the keys present in dict on top of config, nothing is changed
+    // unless every key holds a valid value.
+    //
+    
+    if (!dict)
+        return kIOReturnSuccess;
+    
+    focaltech_config next = *config;
+    OSObject* value;
+    
+    if ((value = dict->getObject("QuietTimeAfterTyping"))) {
+        OSNumber* number = OSDynamicCast(OSNumber, value);
+        if (!number || number->unsigned64BitValue() > kConfigMaxQuietTime)
+            return kIOReturnBadArgument;
+        next.quiet_time = _clock.toTicks(number->unsigned64BitValue() * 1000000);
+    }
+    
+    if ((value = dict->getObject("ButtonDebounceTime"))) {
+        OSNumber* number = OSDynamicCast(OSNumber, value);
+        if (!number || number->unsigned64BitValue() > kConfigMaxDebounceTime)
+            return kIOReturnBadArgument;
+        next.button_debounce = _clock.toTicks(number->unsigned64BitValue() * 1000000);
+    }
+    
+    if ((value = dict->getObject("RingBufferOverflowPolicy"))) {
+        OSString* string = OSDynamicCast(OSString, value);
+        if (string && string->isEqualTo("DropOldest"))
+            next.overflow_policy = kOverflowDropOldest;
+        else if (string && string->isEqualTo("DropNewest"))
+            next.overflow_policy = kOverflowDropNewest;
+        else
+            return kIOReturnBadArgument;
+    }
+    
+    if ((value = dict->getObject("RelativePointerDivisor"))) {
+        OSNumber* number = OSDynamicCast(OSNumber, value);
+        if (!number || number->unsigned32BitValue() < 1 || number->unsigned32BitValue() > kConfigMaxDivisor)
+            return kIOReturnBadArgument;
+        next.pointer_divisor = number->unsigned32BitValue();
+    }
+    
+    if ((value = dict->getObject("RelativeScrollDivisor"))) {
+        OSNumber* number = OSDynamicCast(OSNumber, value);
+        if (!number || number->unsigned32BitValue() < 1 || number->unsigned32BitValue() > kConfigMaxDivisor)
+            return kIOReturnBadArgument;
+        next.scroll_divisor = number->unsigned32BitValue();
+    }
+    
+    if ((value = dict->getObject("WatchdogEnabled"))) {
+        OSBoolean* boolean = OSDynamicCast(OSBoolean, value);
+        if (!boolean)
+            return kIOReturnBadArgument;
+        next.watchdog = boolean->isTrue();
+    }
+    
+    *config = next;
+    return kIOReturnSuccess;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void ApplePS2FocalTechTouchPad::readConfig(focaltech_config* config) {
+    //
+    // Snapshots are never modified while in use: setProperties fills the
+    // spare slot and flips the generation. A slot is only refilled after the
+    // generation moved past it, so a copy is consistent if the generation did
+    // not change while it was taken.
+    //
+    
+    UInt32 generation;
+    do {
+        generation = __atomic_load_n(&_configGeneration, __ATOMIC_ACQUIRE);
+        *config = _configs[generation & 1];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (generation != __atomic_load_n(&_configGeneration, __ATOMIC_RELAXED));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+IOReturn ApplePS2FocalTechTouchPad::setProperties(OSObject* props) {
+    OSDictionary* dict = OSDynamicCast(OSDictionary, props);
+    if (!dict)
+        return super::setProperties(props);
+    
+#ifdef FOCALTECH_PROFILING
+    OSData* trace = OSDynamicCast(OSData, dict->getObject("ReplayTrace"));
+    OSObject* gestures = dict->getObject("ReplayGesture");
+    if (trace || gestures) {
+        focaltech_replay_check check;
+        if (parseReplayCheck(dict, &check) != kIOReturnSuccess)
+            return kIOReturnBadArgument;
+        return trace ? replayTrace(trace, &check) : replayGestures(gestures, &check);
+    }
+    if (OSBoolean* cycles = OSDynamicCast(OSBoolean, dict->getObject("ProfileCycles"))) {
+        ProfileSample::countCycles(cycles->isTrue());
+        setProperty("ProfileCycles", ProfileSample::countsCycles());
+        return kIOReturnSuccess;
+    }
+#endif
+    
+    // one writer at a time, readers never wait
+    if (!OSCompareAndSwap(0, 1, &_configWriter))
+        return kIOReturnBusy;
+    
+    UInt32 generation = _configGeneration;
+    focaltech_config next = _configs[generation & 1];
+    IOReturn result = parseConfig(dict, &next);
+    if (result == kIOReturnSuccess) {
+        _configs[(generation + 1) & 1] = next;
+        __atomic_store_n(&_configGeneration, generation + 1, __ATOMIC_RELEASE);
+    }
+    
+    __atomic_store_n(&_configWriter, 0, __ATOMIC_RELEASE);
+    
+    if (result != kIOReturnSuccess) {
+        IOLog("%s :: rejected configuration update\n", getName());
+        return result;
+    }
+    
+    // reflect the accepted values in the registry
+    static const char* const keys[] = {"QuietTimeAfterTyping", "ButtonDebounceTime", "RingBufferOverflowPolicy", "RelativePointerDivisor", "RelativeScrollDivisor", "WatchdogEnabled"};
+    for (unsigned i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        OSObject* value = dict->getObject(keys[i]);
+        if (value)
+            setProperty(keys[i], value);
+    }
+    return kIOReturnSuccess;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void ApplePS2FocalTechTouchPad::publishStatistics()
+{
+    OSDictionary* dict = OSDictionary::withCapacity(15);
+    if (!dict)
+        return;
+    
+    setOSDictionaryNumber(dict, "RingOverflows", _stats.ring_overflows);
+    setOSDictionaryNumber(dict, "RingHighWater", _stats.ring_high_water);
+    setOSDictionaryNumber64(dict, "LostBytes", _stats.lost_bytes);
+    setOSDictionaryNumber64(dict, "RejectedBytes", _stats.rejected_bytes);
+    setOSDictionaryNumber64(dict, "PointerEventsAvoided", _stats.pointer_events_avoided);
+    setOSDictionaryNumber64(dict, "IdleFramesSuppressed", _stats.idle_frames_suppressed);
+    setOSDictionaryNumber64(dict, "FramesDropped", _stats.frames_dropped);
+    setOSDictionaryNumber(dict, "Realigns", _stats.resets[kResetRealign]);
+    setOSDictionaryNumber(dict, "ModeSwitches", _stats.resets[kResetSwitchMode]);
+    setOSDictionaryNumber(dict, "FullResets", _stats.resets[kResetFull]);
+    setOSDictionaryNumber(dict, "ResetsCoalesced", _stats.resets_coalesced);
+    setOSDictionaryNumber(dict, "RejectFaults", _stats.reject_faults);
+    setOSDictionaryNumber(dict, "GapFaults", _stats.gap_faults);
+    setOSDictionaryNumber(dict, "StuckFaults", _stats.stuck_faults);
+    setOSDictionaryNumber64(dict, "LastRecoveryTime", _stats.last_recovery_ms);
+    
+    setProperty("Statistics", dict);
+    dict->release();
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 void ApplePS2FocalTechTouchPad::parsePacket(UInt8* packet)
 {
-    if (!(_fingerCount > 2))
+    // Use the finger count of this packet, _fingerCount already belongs to
+    // the packet currently being received at interrupt time
+    if (!(FOCALTECH_FINGER_COUNT(packet[4]) > 2))
         for (int i = 8; i < kPacketLengthMax; i++)
-            packet[i] = 0xff;
+            packet[i] = FOCALTECH_SLOT_INVALID;
     
-    if ((packet[0] & 1) == 1)   // Left Button
-        left = 1;
-    else
-        left = 0;
-    if ((packet[0] & 2) == 2)   // Right Button
-        right = 1;
-    else
-        right = 0;
-    if ((packet[0] & 48) != 16)
+    // stream health, see watchdogTick
+    _lastPacketTime = _parseArrival;
+    if (memcmp(packet, _lastDeviceData, kPacketLengthMax) != 0)
+    {
+        memcpy(_lastDeviceData, packet, kPacketLengthMax);
+        _lastChangeTime = _lastPacketTime;
+    }
+    _contactsActive = false;
+    _packetInconsistent = false;
+    
+    left  = (packet[0] & FOCALTECH_BUTTON_LEFT)  ? 1 : 0;
+    right = (packet[0] & FOCALTECH_BUTTON_RIGHT) ? 1 : 0;
+    
+    if (FOCALTECH_HAS_CONTACTS(packet))
     {
-        for (int i = 0; i < 4; i++)
+        int count = 0;
+        for (int i = 0; i < FOCALTECH_MAX_FINGERS; i++)
         {
-            int j = (i * 4);
-            if (!(packet[j+1] == 0xff && packet[j+2] == 0xff && packet[j+3] == 0xff))
+            UInt8* slot = FOCALTECH_SLOT(packet, i);
+            if (FOCALTECH_SLOT_VALID(slot))
             {
+                count++;
                 fingerStates[i].valid = true;
-                fingerStates[i].x = (packet[j+1] << 4) + ((packet[j+3] & 0xf0) >> 4);
-                fingerStates[i].y = (packet[j+2] << 4) + (packet[j+3] & 0x0f);
+                fingerStates[i].x = FOCALTECH_SLOT_X(slot);
+                fingerStates[i].y = FOCALTECH_SLOT_Y(slot);
+                // 12-bit coordinates can exceed the logical range on noisy packets
+                if (fingerStates[i].x > LOGICAL_MAX_X || fingerStates[i].y > LOGICAL_MAX_Y)
+                    _packetInconsistent = true;
+                if (fingerStates[i].x > LOGICAL_MAX_X)
+                    fingerStates[i].x = LOGICAL_MAX_X;
+                if (fingerStates[i].y > LOGICAL_MAX_Y)
+                    fingerStates[i].y = LOGICAL_MAX_Y;
             }
             else
                 fingerStates[i].valid = false;
         }
-        sendTouchDataToMultiTouchInterface();
+        _contactsActive = (count > 0);
+        if (count != FOCALTECH_FINGER_COUNT(packet[4]))
+            _packetInconsistent = true;
+        
+        // Only report button transitions, a bounce within ButtonDebounceTime
+        // of the previous transition is ignored. Decided here, before the
+        // frame can be suppressed, so a bounce never becomes the idle state
+        focaltech_config config;
+        readConfig(&config);
+        UInt32 buttons = (left ? 0x01 : 0) | (right ? 0x02 : 0);
+        if (buttons != _debouncedButtons)
+        {
+            if (config.button_debounce > 0 && _lastPacketTime - lastbuttontime < config.button_debounce)
+                buttons = _debouncedButtons;
+            else
+            {
+                _debouncedButtons = buttons;
+                lastbuttontime = _lastPacketTime;
+            }
+        }
+        
+        // Once the lift frame has gone out, identical empty frames carry no
+        // information, skip them until a finger lands or a button changes
+        if (count == 0 && _idleFrameSent && buttons == _idleFrameButtons)
+        {
+            _stats.idle_frames_suppressed++;
+            return;
+        }
+        
+        // a frame that was not queued is retried with the next packet
+        PROFILE_START(send_start);
+        bool sent = sendTouchDataToMultiTouchInterface(config, buttons);
+        PROFILE_STOP(_profile[kProfileSendTouchData], send_start, 1, _profilePending);
+        if (sent)
+        {
+            _idleFrameSent = (count == 0);
+            _idleFrameButtons = buttons;
+        }
     }
 }
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
-void ApplePS2FocalTechTouchPad::sendTouchDataToMultiTouchInterface() {
+bool ApplePS2FocalTechTouchPad::sendTouchDataToMultiTouchInterface(const focaltech_config& config, UInt32 buttons) {
     if(!mt_interface)
-        return;
+        return false;
     
-    UInt32 buttons = 0;
-    buttons |= left  ? 0x01 : 0;
-    buttons |= right ? 0x02 : 0;
+    AbsoluteTime timestamp = _parseArrival;
     
-    AbsoluteTime timestamp;
-    clock_get_uptime(&timestamp);
-    uint64_t timestamp_ns;
-    absolutetime_to_nanoseconds(timestamp, &timestamp_ns);
+    if ((config.quiet_time > 0) && (timestamp - keytime < config.quiet_time))
+        return false;
     
-    if ((maxaftertyping > 0) && (timestamp_ns - keytime < maxaftertyping))
-        return;
+    // The engines still own every queued slot, drop the frame rather than
+    // overwrite transducers they may be reading
+    UInt32 head = _frameHead;
+    if (head - __atomic_load_n(&_frameTail, __ATOMIC_ACQUIRE) == kFrameQueueSlots) {
+        _stats.frames_dropped++;
+        return false;
+    }
+    
+    // Fill the slot's transducer set, starting from the state of the previous
+    // frame so that current/last values chain across the queue
+    OSArray* previous = transducers[(head - 1) % kFrameQueueSlots];
+    OSArray* frame = transducers[head % kFrameQueueSlots];
     
     int count = 0;
     for (int i = 0; i < FOCALTECH_MAX_FINGERS; i++) {
         focaltech_hw_state *state = &fingerStates[i];
-        VoodooPS2DigitiserTransducer* transducer = OSDynamicCast(VoodooPS2DigitiserTransducer, transducers->getObject(i));
-        transducer->type = kDigitiserTransducerFinger;
-        if(!transducer)
+        VoodooPS2DigitiserTransducer* transducer = OSDynamicCast(VoodooPS2DigitiserTransducer, frame->getObject(i));
+        VoodooPS2DigitiserTransducer* last = OSDynamicCast(VoodooPS2DigitiserTransducer, previous->getObject(i));
+        if(!transducer || !last)
             continue;
         
+        transducer->type = kDigitiserTransducerFinger;
+        transducer->coordinates = last->coordinates;
+        transducer->tip_switch = last->tip_switch;
+        transducer->timestamp = last->timestamp;
+        transducer->stamp(timestamp);
         transducer->is_valid = state->valid;
         
         if(state->valid){
-            if(mt_interface){
-                transducer->logical_max_x = mt_interface->logical_max_x;
-                transducer->logical_max_y = mt_interface->logical_max_y;
-            }
-            transducer->coordinates.x.update(state->x, timestamp);
-            transducer->coordinates.y.update(state->y, timestamp);
-            transducer->tip_switch.update(1, timestamp);
+            transducer->coordinates.x.update(state->x);
+            transducer->coordinates.y.update(state->y);
+            transducer->tip_switch.update(1);
             transducer->id = i;
             transducer->secondary_id = i;
             count++;
         } else{
             transducer->id = i;
             transducer->secondary_id = i;
-            transducer->coordinates.x.update(transducer->coordinates.x.last.value, timestamp);
-            transducer->coordinates.y.update(transducer->coordinates.y.last.value, timestamp);
-            transducer->tip_switch.update(0, timestamp);
+            transducer->coordinates.x.update(transducer->coordinates.x.last());
+            transducer->coordinates.y.update(transducer->coordinates.y.last());
+            transducer->tip_switch.update(0);
         }
     }
-    VoodooI2CMultitouchEvent event;
-    event.contact_count = count;
-    event.transducers = transducers;
-    if (mt_interface){
-        mt_interface->handleInterruptReport(event, timestamp);
-        dispatchRelativePointerEvent(0, 0, buttons, timestamp);
+    
+    UInt32 slot = head % kFrameQueueSlots;
+    VoodooI2CMultitouchFrame* queued = &_frames[slot];
+    queued->event.contact_count = count;
+    queued->event.transducers = frame;
+    queued->event.features = NULL;
+    queued->timestamp = timestamp;
+    _frameButtons[slot] = buttons;
+#ifdef FOCALTECH_PROFILING
+    _frameQueued[slot] = mach_absolute_time();
+    _frameArrival[slot] = _parseLatencyArrival;
+#endif
+    
+    // publish the slot, the engine work loop is kicked at the end of packetReady
+    __atomic_store_n(&_frameHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void ApplePS2FocalTechTouchPad::drainFrameQueue(IOInterruptEventSource* sender, int count) {
+    //
+    // Runs on the engine work loop: the engines, VoodooInput and the pointer
+    // events of the built-in mode never hold up the PS/2 work loop, which the
+    // keyboard shares.
+    //
+    
+    focaltech_config config;
+    readConfig(&config);
+    
+    UInt32 tail = _frameTail;
+    UInt32 head = __atomic_load_n(&_frameHead, __ATOMIC_ACQUIRE);
+    
+    while (mt_interface && tail != head) {
+        UInt32 first = tail % kFrameQueueSlots;
+        UInt32 run = (head - tail < kFrameQueueSlots - first) ? head - tail : kFrameQueueSlots - first;
+        
+        // one engine pass for every contiguous run of queued frames
+#ifdef FOCALTECH_PROFILING
+        uint64_t drained = mach_absolute_time();
+#endif
+        mt_interface->handleInterruptReports(&_frames[first], run);
+#ifdef FOCALTECH_PROFILING
+        uint64_t dispatched = mach_absolute_time();
+        for (UInt32 k = first; k < first + run; k++) {
+            _latency[kLatencyQueue].record(_frameQueued[k], drained);
+            _latency[kLatencyDispatch].record(drained, dispatched);
+            _latency[kLatencyTotal].record(_frameArrival[k], dispatched);
+        }
+#endif
+        
+        for (UInt32 k = first; k < first + run; k++) {
+            VoodooI2CMultitouchFrame* frame = &_frames[k];
+            UInt32 buttons = _frameButtons[k];
+            int dx = 0, dy = 0;
+        
+            // Nobody (e.g. VoodooInput) took the frame, move the pointer ourselves
+            if (frame->result == MultitouchReturnContinue)
+                relativePointerFallback(config, frame->event.transducers, frame->event.contact_count, frame->timestamp, &dx, &dy);
+            else
+                _relativeContacts = 0;
+        
+            // Only report button transitions, parsePacket debounced them
+            bool transition = buttons != _lastButtons;
+        
+            if (!transition && dx == 0 && dy == 0) {
+                OSIncrementAtomic64((volatile SInt64*)&_stats.pointer_events_avoided);
+                continue;
+            }
+        
+            if (transition)
+                _lastButtons = buttons;
+            if (!replaying())
+                dispatchRelativePointerEvent(dx, dy, _lastButtons | _engineButtons, _clock.uptime(frame->timestamp));
+#ifdef FOCALTECH_PROFILING
+            recordPointer(dx, dy, _lastButtons | _engineButtons);
+#endif
+        }
+        
+        tail += run;
+        __atomic_store_n(&_frameTail, tail, __ATOMIC_RELEASE);
+        head = __atomic_load_n(&_frameHead, __ATOMIC_ACQUIRE);
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void ApplePS2FocalTechTouchPad::relativePointerFallback(const focaltech_config& config, OSArray* frame, int count, AbsoluteTime timestamp, int* dx, int* dy) {
+    //
+    // Lightweight relative mode: one finger moves the pointer, two fingers
+    // scroll. Motion is only reported while the contact count is unchanged,
+    // the first frame after a finger lands or lifts only resets the state.
+    //
+    
+    if (count != _relativeContacts || count == 0 || count > 2) {
+        _relativeContacts = count;
+        _relativeRemainderX = 0;
+        _relativeRemainderY = 0;
+        return;
+    }
+    
+    int sum_dx = 0, sum_dy = 0;
+    for (int i = 0; i < FOCALTECH_MAX_FINGERS; i++) {
+        VoodooPS2DigitiserTransducer* transducer = OSDynamicCast(VoodooPS2DigitiserTransducer, frame->getObject(i));
+        if (!transducer || !transducer->tip_switch.value() || !transducer->tip_switch.last())
+            continue;
+        
+        sum_dx += transducer->coordinates.x.value() - transducer->coordinates.x.last();
+        sum_dy += transducer->coordinates.y.value() - transducer->coordinates.y.last();
+    }
+    
+    // average over the fingers, keep what the divisor cuts off for next time
+    int divisor = (count == 1) ? config.pointer_divisor : config.scroll_divisor * count;
+    sum_dx += _relativeRemainderX;
+    sum_dy += _relativeRemainderY;
+    _relativeRemainderX = sum_dx % divisor;
+    _relativeRemainderY = sum_dy % divisor;
+    
+    if (count == 1) {
+        *dx = sum_dx / divisor;
+        *dy = sum_dy / divisor;
+    } else if (sum_dx / divisor || sum_dy / divisor) {
+        // wheel convention: positive deltas scroll towards the top/left
+        if (!replaying())
+            dispatchScrollWheelEvent(-(sum_dy / divisor), -(sum_dx / divisor), 0, _clock.uptime(timestamp));
+#ifdef FOCALTECH_PROFILING
+        recordScroll(-(sum_dy / divisor), -(sum_dx / divisor));
+#endif
     }
 }
 
@@ -466,6 +1393,7 @@ void ApplePS2FocalTechTouchPad::setDevicePowerState( UInt32 whatToDo )
             // Disable touchpad.
             //
             setTouchPadEnable( false );
+            _contactsActive = false;
             break;
             
         case kPS2C_EnableDevice:
@@ -477,6 +1405,8 @@ void ApplePS2FocalTechTouchPad::setDevicePowerState( UInt32 whatToDo )
             
             _ringBuffer.reset();
             _packetByteCount = 0;
+            _isReadNext = false;
+            _idleFrameSent = false;
             
             setTouchPadEnable(true);
             break;
@@ -564,6 +1494,186 @@ void ApplePS2FocalTechTouchPad::getProductID(FTE_BYTES_t *bytes){
     IOLog("%s :: Product ID: [%02x %02x %02x]\n", getName(), bytes->byte0, bytes->byte1, bytes->byte2);
 }
 
+void ApplePS2FocalTechTouchPad::requestReset(UInt32 level) {
+    //
+    // Called from the keyboard's notification and from the watchdog, neither
+    // may wait for device resets. The reset runs on a thread call, a request
+    // arriving while one is queued is folded into it, one arriving while a
+    // reset runs makes it run once more. Either way the highest requested
+    // level wins.
+    //
+    
+    if (__atomic_load_n(&_stopping, __ATOMIC_ACQUIRE))
+        return;
+    
+    UInt32 pending = _resetLevel;
+    while (pending < level && !OSCompareAndSwap(pending, level, &_resetLevel))
+        pending = _resetLevel;
+    
+    for (;;) {
+        UInt32 state = _resetState;
+        UInt32 next = state;
+        
+        if (state == kResetIdle)
+            next = kResetQueued;
+        else if (state == kResetRunning)
+            next = kResetRunningRequeued;
+        
+        if (next == state) {
+            OSIncrementAtomic((volatile SInt32*)&_stats.resets_coalesced);
+            return;
+        }
+        
+        if (OSCompareAndSwap(state, next, &_resetState)) {
+            if (state == kResetIdle)
+                thread_call_enter(_resetCall);
+            return;
+        }
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void ApplePS2FocalTechTouchPad::resetCallout(thread_call_param_t param0, thread_call_param_t param1) {
+    ((ApplePS2FocalTechTouchPad*)param0)->performReset();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void ApplePS2FocalTechTouchPad::performReset() {
+    // entered by a request that raced with stop, the device is gone
+    if (__atomic_load_n(&_stopping, __ATOMIC_ACQUIRE)) {
+        _resetState = kResetIdle;
+        return;
+    }
+    
+    OSCompareAndSwap(kResetQueued, kResetRunning, &_resetState);
+    
+    do {
+        // a requeue that arrives from here on runs another reset
+        OSCompareAndSwap(kResetRunningRequeued, kResetRunning, &_resetState);
+        
+        UInt32 level = _resetLevel;
+        while (!OSCompareAndSwap(level, 0, &_resetLevel))
+            level = _resetLevel;
+        if (level < kResetRealign)
+            continue;
+        if (level > kResetFull)
+            level = kResetFull;
+        
+        // the stream state belongs to the PS/2 work loop
+        getWorkLoop()->runAction(OSMemberFunctionCast(IOWorkLoop::Action, this, &ApplePS2FocalTechTouchPad::realignStream), this, (void*)(uintptr_t)level);
+        
+        if (level >= kResetSwitchMode) {
+            _device->lock();
+            if (level == kResetFull)
+                doHardwareReset();
+            switchProtocol();
+            setTouchPadEnable(true);
+            _device->unlock();
+        }
+        OSIncrementAtomic((volatile SInt32*)&_stats.resets[level]);
+    } while (!OSCompareAndSwap(kResetRunning, kResetIdle, &_resetState));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+IOReturn ApplePS2FocalTechTouchPad::realignStream(void* level, void* unused1, void* unused2, void* unused3) {
+    //
+    // On the PS/2 work loop, next to packetReady. Discards the queued packets
+    // and has receiveByte drop the one it is receiving, so framing starts
+    // over at the next byte0.
+    //
+    
+    IOInterruptState state = IOSimpleLockLockDisableInterrupt(_ringLock);
+    _ringBuffer.advanceTail(_ringBuffer.count());
+    IOSimpleLockUnlockEnableInterrupt(_ringLock, state);
+    __atomic_store_n(&_realignPending, true, __ATOMIC_RELEASE);
+    
+    _idleFrameSent = false;
+    _lastChangeTime = _clock.now();
+    if ((uintptr_t)level == kResetFull)
+        _contactsActive = false;
+    return kIOReturnSuccess;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
+void ApplePS2FocalTechTouchPad::watchdogTick(IOTimerEventSource* sender) {
+    //
+    // Runs on the PS/2 work loop, next to packetReady. Looks for a stream that
+    // went out of sync: framing rejecting bytes, no packets although fingers
+    // are down, or a device repeating the same malformed packet (a resting
+    // finger repeats a valid one). A realign is done right here, the higher
+    // levels request a reset in the background. Faults that keep coming back
+    // escalate from a realign to a mode switch to a full reset.
+    //
+    
+    AbsoluteTime now = _clock.now();
+    uint64_t since_packet_ns, since_change_ns, since_reset_ns;
+    
+    // the statistics are published from here only, at most once per interval
+    if (memcmp(&_stats, &_publishedStats, sizeof(_stats)) != 0) {
+        _publishedStats = _stats;
+        publishStatistics();
+    }
+    
+    UInt64 rejected_total = __atomic_load_n(&_stats.rejected_bytes, __ATOMIC_RELAXED);
+    UInt64 rejected = rejected_total - _watchdogRejected;
+    _watchdogRejected = rejected_total;
+    
+    focaltech_config config;
+    readConfig(&config);
+    
+    // judge the stream only once a requested reset has been carried out, and
+    // not while a replay moves the clock
+    if (!config.watchdog || _resetState != kResetIdle || replaying()) {
+        _watchdogTimer->setTimeoutMS(kWatchdogInterval);
+        return;
+    }
+    
+    since_packet_ns = _clock.toNanoseconds(now - _lastPacketTime);
+    since_change_ns = _clock.toNanoseconds(now - _lastChangeTime);
+    
+    UInt32* fault = NULL;
+    if (rejected > kWatchdogRejectLimit)
+        fault = &_stats.reject_faults;
+    else if (_contactsActive && since_packet_ns > kWatchdogGapTime)
+        fault = &_stats.gap_faults;
+    else if (_contactsActive && _packetInconsistent && since_change_ns > kWatchdogStuckTime)
+        fault = &_stats.stuck_faults;
+    
+    if (!fault) {
+        if (_watchdogFaultStart) {
+            _stats.last_recovery_ms = _clock.toNanoseconds(now - _watchdogFaultStart) / 1000000;
+            _watchdogFaultStart = 0;
+        }
+        _watchdogTimer->setTimeoutMS(kWatchdogInterval);
+        return;
+    }
+    
+    (*fault)++;
+    if (!_watchdogFaultStart)
+        _watchdogFaultStart = now;
+    
+    since_reset_ns = _clock.toNanoseconds(now - _watchdogLastReset);
+    if (since_reset_ns > kWatchdogSettleTime)
+        _watchdogLevel = 0;
+    if (_watchdogLevel < kResetFull)
+        _watchdogLevel++;
+    _watchdogLastReset = now;
+    
+    if (_watchdogLevel == kResetRealign) {
+        realignStream((void*)kResetRealign, 0, 0, 0);
+        OSIncrementAtomic((volatile SInt32*)&_stats.resets[kResetRealign]);
+    }
+    else
+        requestReset(_watchdogLevel);
+    _watchdogTimer->setTimeoutMS(kWatchdogInterval);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+
 IOReturn ApplePS2FocalTechTouchPad::message(UInt32 type, IOService* provider, void* argument) {
     // Here is where we receive messages from the keyboard driver
     //
@@ -571,25 +1681,73 @@ IOReturn ApplePS2FocalTechTouchPad::message(UInt32 type, IOService* provider, vo
     //  has been pressed, so it can implement various "ignore trackpad
     //  input while typing" options.
     //
+    //  Keyboard notifications arrive through the controller's gated
+    //  dispatchMessage, on the PS/2 work loop where sendTouchData reads
+    //  keytime. Engine messages arrive on the engine work loop, which also
+    //  owns _lastButtons and _engineButtons, and never touch keytime;
+    //  their keystrokes go out through _device->dispatchMessage, which
+    //  the controller runs behind its command gate.
+    //
     if(type == kPS2M_notifyKeyPressed){
         // remember last time key pressed... this can be used in
         // interrupt handler to detect unintended input while typing
         
         PS2KeyInfo* pInfo = (PS2KeyInfo*)argument;
-        keytime = pInfo->time;
+        // on the pipeline clock, pInfo->time is system uptime
+        keytime = _clock.now();
         
         // Perform a manual Reset Touchpad when F7 key is pressed this help
         // when Touchpad device is disabled accidently, Temprary solution until
         // i understand the functionality of OEM build-in Touchpad Disable Key
         
-        if(pInfo->goingDown && pInfo->adbKeyCode == 0x62){
-            _ringBuffer.reset();
-            _packetByteCount = 0;
-            _device->lock();
-            doHardwareReset();
-            switchProtocol();
-            setTouchPadEnable(true);
-            _device->unlock();
+        if(pInfo->goingDown && pInfo->adbKeyCode == 0x62)
+            requestReset(kResetFull);
+    }
+
+    // Pointer input produced by the multitouch engines
+    if(type == kVoodooPS2MultitouchScroll){
+        VoodooPS2ScrollEvent* scroll = (VoodooPS2ScrollEvent*)argument;
+        if (!replaying())
+            dispatchScrollWheelEvent(scroll->vertical, scroll->horizontal, 0, _clock.uptime(scroll->timestamp));
+#ifdef FOCALTECH_PROFILING
+        recordScroll(scroll->vertical, scroll->horizontal);
+#endif
+    }
+    if(type == kVoodooPS2MultitouchPointer){
+        VoodooPS2PointerEvent* pointer = (VoodooPS2PointerEvent*)argument;
+        _engineButtons = pointer->buttons;
+        if (!replaying())
+            dispatchRelativePointerEvent(pointer->dx, pointer->dy, _lastButtons | _engineButtons, _clock.uptime(pointer->timestamp));
+#ifdef FOCALTECH_PROFILING
+        recordPointer(pointer->dx, pointer->dy, _lastButtons | _engineButtons);
+#endif
+    }
+    if(type == kVoodooPS2MultitouchKeystroke){
+        // the keyboard driver posts the keys, as it does for OEM hotkeys
+        VoodooPS2KeyCombo* combo = (VoodooPS2KeyCombo*)argument;
+        PS2KeyInfo info;
+        // leaves the pipeline, so stamped with uptime like pointer events
+        info.time = _clock.toNanoseconds(_clock.uptime(_clock.now()));
+        info.eatKey = false;
+        info.goingDown = true;
+#ifdef FOCALTECH_PROFILING
+        if (mt_interface) {
+            mt_interface->output_record.event(kOutputKeystroke);
+            mt_interface->output_record.field(kFieldKeyCount, combo->count);
+            for (int i = 0; i < combo->count; i++)
+                mt_interface->output_record.field(kFieldKey, combo->keys[i]);
+        }
+#endif
+        if (replaying())
+            return kIOReturnSuccess;
+        for (int i = 0; i < combo->count; i++) {
+            info.adbKeyCode = combo->keys[i];
+            _device->dispatchMessage(kPS2K_notifyKeystroke, &info);
+        }
+        info.goingDown = false;
+        for (int i = combo->count - 1; i >= 0; i--) {
+            info.adbKeyCode = combo->keys[i];
+            _device->dispatchMessage(kPS2K_notifyKeystroke, &info);
         }
     }
     return kIOReturnSuccess;
@@ -24,33 +24,146 @@
 #define _APPLEPS2FOCALTECHTOUCHPAD_H
 
 #include "VoodooPS2Controller/ApplePS2MouseDevice.h"
+#include "VoodooPS2FocalTechPacket.hpp"
+#include "VoodooPS2FocalTechGesture.hpp"
 #include "Multitouch Support/VoodooPS2MultitouchInterface.hpp"
+#include "Multitouch Support/VoodooPS2Profile.hpp"
 #include "LegacyIOHIPointing.h"
+#include <IOKit/IOWorkLoop.h>
+#include <IOKit/IOInterruptEventSource.h>
+#include <IOKit/IOTimerEventSource.h>
+#include <kern/thread_call.h>
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 // ApplePS2ALPSGlidePoint Class Declaration
 //
 
-#define FOCALTECH_MAX_FINGERS 4
+// Decoded frames travel from the PS/2 work loop to the engine work loop
+// through a single-producer single-consumer ring, each slot owns a set of
+// transducers until the engines are done with it (power of two)
+#define kFrameQueueSlots    32
 
-#define kPacketLengthSmall  8
-#define kPacketLengthLarge  16
-#define kPacketLengthMax    16
+#define kPacketRingSlots    32
+
+// Ring buffer slots are kPacketLengthMax bytes apart, any packet pointer
+// maps to its slot without knowing where the ring starts
+#define FOCALTECH_RING_SLOT(p)  (((uintptr_t)(p) / kPacketLengthMax) % kPacketRingSlots)
 
 #define kGetProductId       0xA7
 #define kSetDeviceMode      0xEA
 #define kDeviceModeAdvanced 0xED
 #define kDeviceModeDefault  0xEE
 
-#define LOGICAL_MAX_X       0x08E0
-#define LOGICAL_MAX_Y       0x03E0
+// Built-in relative mode, used when no multitouch engine consumes a frame
+// (defaults, see RelativePointerDivisor and RelativeScrollDivisor)
+#define kRelativePointerDivisor 4
+#define kRelativeScrollDivisor  16
+
+// Stream health watchdog, faults within the settle time of the previous
+// recovery escalate to the next reset level
+#define kWatchdogInterval       500             // ms
+#define kWatchdogRejectLimit    48              // rejected bytes per interval
+#define kWatchdogGapTime        250000000       // 250 ms
+#define kWatchdogStuckTime      10000000000ULL  // 10 s
+#define kWatchdogSettleTime     30000000000ULL  // 30 s
+
 #define PHYSCICAL_MAX_X     0x0352
 #define PHYSCICAL_MAX_Y     0x0173
 
-struct focaltech_hw_state {
-    int x;
-    int y;
-    bool valid;
+// Ring buffer overflow handling, see RingBufferOverflowPolicy
+enum focaltech_overflow_policy {
+    kOverflowDropNewest,    // keep queued packets, discard the one being received
+    kOverflowDropOldest     // discard the oldest queued packet to make room
+};
+
+// Runtime configuration, replaced as a whole through setProperties. The
+// interrupt and work loop paths take a consistent copy without locking,
+// see readConfig
+struct focaltech_config {
+    AbsoluteTime quiet_time;    // QuietTimeAfterTyping (ms), in mach ticks
+    AbsoluteTime button_debounce; // ButtonDebounceTime (ms), in mach ticks
+    focaltech_overflow_policy overflow_policy; // RingBufferOverflowPolicy
+    int pointer_divisor;        // RelativePointerDivisor
+    int scroll_divisor;         // RelativeScrollDivisor
+    bool watchdog;              // WatchdogEnabled
+};
+
+#define kConfigMaxQuietTime     5000    // ms
+#define kConfigMaxDebounceTime  500     // ms
+#define kConfigMaxDivisor       256
+
+// Traces replayed through setProperties ("ReplayTrace" or generated from
+// "ReplayGesture", FOCALTECH_PROFILING builds), see VoodooPS2FocalTechPacket.hpp.
+// The delays advance virtual time, the replay itself does not wait. After
+// the last record virtual time runs on for kReplaySettleTime, so momentum
+// and tap timers finish before the output is published.
+#define kReplaySettleTime       5000000 // us
+#define kReplayMaxGestures      16
+
+// Steps of a replay on the engine work loop, see replayDrain
+enum focaltech_replay_phase {
+    kReplayStart,       // reset engine state, start recording the output
+    kReplayStep,        // deliver the frames of the last record
+    kReplayFinish       // publish and check the output, reset engine state
+};
+
+// What the output of a replay is checked against, see OutputRecord::compare
+struct focaltech_replay_check {
+    OSArray* expected;                      // ReplayExpected, NULL to only publish the output
+    SInt32 tolerance[kToleranceClasses];    // ReplayTolerance
+};
+
+// Touchpad reset requests (F7 and the watchdog), duplicates coalesce into
+// the pending reset, which runs at the highest level requested
+enum focaltech_reset_level {
+    kResetRealign = 1,      // drop partial packets and resync framing
+    kResetSwitchMode,       // also switch the device to the advanced protocol again
+    kResetFull              // also reset the device
+};
+
+enum focaltech_reset_state {
+    kResetIdle,
+    kResetQueued,           // thread call entered, not running yet
+    kResetRunning,
+    kResetRunningRequeued   // requested again while running, runs once more
+};
+
+// Counters written outside the PS/2 work loop (interrupt time, the engine
+// work loop, the reset thread call) are updated atomically, the watchdog
+// tick on the PS/2 work loop is the only reader
+struct focaltech_stats {
+    UInt32 ring_overflows;      // packets that did not fit into the ring buffer
+    UInt32 ring_high_water;     // most packets ever queued at once
+    UInt64 lost_bytes;          // bytes of packets dropped on overflow
+    UInt64 rejected_bytes;      // bytes discarded while looking for byte0
+    UInt64 pointer_events_avoided; // frames without a button transition
+    UInt64 idle_frames_suppressed; // empty frames after the lift frame
+    UInt64 frames_dropped;      // frames that found the engine queue full
+    UInt32 resets[kResetFull + 1]; // resets carried out, by level
+    UInt32 resets_coalesced;    // reset requests folded into a pending one
+    UInt32 reject_faults;       // watchdog: too many bytes rejected by framing
+    UInt32 gap_faults;          // watchdog: no packets while fingers are down
+    UInt32 stuck_faults;        // watchdog: identical malformed packets while fingers are down
+    UInt64 last_recovery_ms;    // watchdog: first fault until the stream was healthy again
+};
+
+// Hot path stages timed in FOCALTECH_PROFILING builds, published under "Profile"
+enum focaltech_profile_stage {
+    kProfileInterruptByte,      // interruptOccurred, per byte
+    kProfilePacketReady,        // packetReady, per packet drained
+    kProfileParseTwoFingers,    // parsePacket, 8-byte packets
+    kProfileParseFourFingers,   // parsePacket, 16-byte packets
+    kProfileSendTouchData,      // sendTouchDataToMultiTouchInterface
+    kProfileStages
+};
+
+// End-to-end latency of a frame, published with the profile
+enum focaltech_latency_phase {
+    kLatencyDeferral,           // first byte received until parsePacket
+    kLatencyQueue,              // frame queued until the engine work loop drains it
+    kLatencyDispatch,           // drain until the engines are done with it
+    kLatencyTotal,              // first byte received until the engines are done
+    kLatencyPhases
 };
 
 typedef struct FTE_BYTES
@@ -67,10 +180,26 @@ class EXPORT ApplePS2FocalTechTouchPad : public IOHIPointing
     
 private:
     ApplePS2MouseDevice * _device;
-    RingBuffer<UInt8,kPacketLengthMax*32> _ringBuffer;
+    RingBuffer<UInt8,kPacketLengthMax*kPacketRingSlots> _ringBuffer;
     UInt32                _packetByteCount;
-    uint64_t              keytime;
-    uint64_t              maxaftertyping;
+    volatile bool         _realignPending;  // set by realignStream, cleared by receiveByte
+    IOSimpleLock*         _ringLock;    // receiveByte and packetReady both move the tail
+    focaltech_stats       _stats;
+    focaltech_stats       _publishedStats;  // as of the last watchdog tick
+    focaltech_config      _configs[2];  // the snapshot in use and the next one
+    volatile UInt32       _configGeneration; // selects the snapshot in use
+    volatile UInt32       _configWriter;
+    AbsoluteTime          keytime;      // on _clock
+    VoodooPS2Clock        _clock;
+    AbsoluteTime          lastbuttontime;   // of the last debounced transition
+    UInt32                _debouncedButtons;
+    UInt32                _lastButtons;     // last reported by drainFrameQueue
+    UInt32                _engineButtons;
+    bool                  _idleFrameSent;
+    UInt32                _idleFrameButtons;
+    int                   _relativeContacts;
+    int                   _relativeRemainderX;
+    int                   _relativeRemainderY;
     int                   _fingerCount;
     bool                  _interruptHandlerInstalled;
     bool                  _powerControlHandlerInstalled;
@@ -79,15 +208,82 @@ private:
     FTE_BYTES_t           bytes;
     UInt8                 _isReadNext;
     UInt8                 _lastDeviceData[16];
-    OSArray*              transducers;
+    OSArray*              transducers[kFrameQueueSlots];
+    VoodooI2CMultitouchFrame _frames[kFrameQueueSlots];
+    UInt32                _frameButtons[kFrameQueueSlots];
+    UInt32                _frameHead;   // advanced by the PS/2 work loop only
+    UInt32                _frameTail;   // advanced by the engine work loop only
+    IOWorkLoop*           _engineWorkLoop;
+    IOInterruptEventSource* _engineSource;
+    thread_call_t         _resetCall;   // freed in free(), requestReset may still hold it
+    volatile bool         _stopping;
+    volatile UInt32       _resetState;
+    volatile UInt32       _resetLevel;
+    IOTimerEventSource*   _watchdogTimer;
+    UInt32                _watchdogLevel;
+    UInt64                _watchdogRejected;
+    AbsoluteTime          _watchdogFaultStart;
+    AbsoluteTime          _watchdogLastReset;
+    AbsoluteTime          _packetArrival[kPacketRingSlots]; // first byte on _clock, by ring slot
+    AbsoluteTime          _parseArrival;    // of the packet being parsed
+    AbsoluteTime          _lastPacketTime;
+    AbsoluteTime          _lastChangeTime;
+    bool                  _contactsActive;
+    bool                  _packetInconsistent; // last packet clamped or miscounted its fingers
     VoodooPS2MultitouchInterface* mt_interface;
+#ifdef FOCALTECH_PROFILING
+    ProfileStage          _profile[kProfileStages];
+    LatencyHistogram      _latency[kLatencyPhases];
+    uint64_t              _frameQueued[kFrameQueueSlots];
+    // latencies are measured in mach time, _packetArrival is virtual during a replay
+    AbsoluteTime          _latencyArrival[kPacketRingSlots];    // first byte, by ring slot
+    AbsoluteTime          _parseLatencyArrival;                 // of the packet being parsed
+    uint64_t              _frameArrival[kFrameQueueSlots];      // of the packet a queued frame came from
+    bool                  _profilePending;
+    volatile bool         _liveByte;        // interruptOccurred is handling a device byte
+#endif
     
     struct focaltech_hw_state fingerStates[FOCALTECH_MAX_FINGERS];
     
     bool publish_multitouch_interface();
     void unpublish_multitouch_interface();
     bool init_multitouch_interface();
-    void sendTouchDataToMultiTouchInterface();
+    bool sendTouchDataToMultiTouchInterface(const focaltech_config& config, UInt32 buttons);
+    void drainFrameQueue(IOInterruptEventSource* sender, int count);
+    void relativePointerFallback(const focaltech_config& config, OSArray* frame, int count, AbsoluteTime timestamp, int* dx, int* dy);
+    void publishStatistics();
+#ifdef FOCALTECH_PROFILING
+    void publishProfile();
+    void recordPointer(int dx, int dy, UInt32 buttons);
+    void recordScroll(int vertical, int horizontal);
+    IOReturn replayTrace(OSData* trace, const focaltech_replay_check* check);
+    IOReturn replayGestures(OSObject* gestures, const focaltech_replay_check* check);
+    IOReturn parseGesture(OSDictionary* dict, FocalTechGesture* gesture);
+    IOReturn parseReplayCheck(OSDictionary* dict, focaltech_replay_check* check);
+    IOReturn replayPacket(void* bytes, void* length, void* unused1, void* unused2);
+    IOReturn replayDrain(void* phase, void* check, void* unused2, void* unused3);
+    IOReturn replayReset(void* unused0, void* unused1, void* unused2, void* unused3);
+    IOReturn replayTimers(void* unused0, void* unused1, void* unused2, void* unused3);
+    PS2InterruptResult timedReceiveByte(UInt8 data);
+#endif
+    PS2InterruptResult receiveByte(UInt8 data);
+
+    // while a trace replays nothing leaves the driver, see replayTrace
+    inline bool replaying() const {
+#ifdef FOCALTECH_PROFILING
+        return mt_interface && __atomic_load_n(&mt_interface->replaying, __ATOMIC_ACQUIRE);
+#else
+        return false;
+#endif
+    }
+
+    IOReturn parseConfig(OSDictionary* dict, focaltech_config* config);
+    void readConfig(focaltech_config* config);
+    void requestReset(UInt32 level);
+    void performReset();
+    IOReturn realignStream(void* level, void* unused1, void* unused2, void* unused3);
+    void watchdogTick(IOTimerEventSource* sender);
+    static void resetCallout(thread_call_param_t param0, thread_call_param_t param1);
     
 protected:
     virtual void   doHardwareReset();
@@ -106,11 +302,13 @@ public:
     
     bool start( IOService * provider ) override;
     void stop( IOService * provider ) override;
+    void free() override;
     
     UInt32 deviceType() override;
     UInt32 interfaceID() override;
     
     virtual IOReturn message(UInt32 type, IOService* provider, void* argument) override;
+    IOReturn setProperties(OSObject* props) override;
 };
 
 #endif /* _APPLEPS2FOCALTECHTOUCHPAD_H */
@@ -0,0 +1,203 @@
+//
+//  VoodooPS2FocalTechGesture.hpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#ifndef VoodooPS2FocalTechGesture_hpp
+#define VoodooPS2FocalTechGesture_hpp
+
+#include "VoodooPS2FocalTechPacket.hpp"
+
+// Scripted gestures rendered as replay traces, so the pipeline can be fed
+// known trajectories without a touchpad. Every report places the fingers
+// where <FocalTechGestureGenerator::position> says, plus uniform noise from a
+// seeded generator, and encodes them with encodeFocalTechPacket. A gesture
+// ends with a lift report. Integer math only, the generator also runs in the
+// kernel, and the same gesture and seed always give the same bytes.
+
+#define kGestureFingerSpacing   240     // logical units between resting fingers
+#define kGestureMaxDuration     10000   // ms
+#define kGestureMaxRate         1000    // reports per second
+#define kGestureAngleShift      16      // angles are in 1/65536 turns
+#define kGestureTrigShift       14      // sines are Q14
+
+enum FocalTechGestureKind {
+    kGestureSwipe,      // fingers side by side move by delta
+    kGesturePinch,      // fingers on a circle, its radius goes from radius to radius_end
+    kGestureRotate,     // fingers on a circle, turning by rotation degrees
+    kGestureTap,        // fingers rest for duration
+    kGestureDrag        // like a swipe, with the left button held
+};
+
+struct FocalTechGesture {
+    FocalTechGestureKind kind = kGestureSwipe;
+    int fingers = 1;
+    int center_x = LOGICAL_MAX_X / 2;
+    int center_y = LOGICAL_MAX_Y / 2;
+    int delta_x = 0;
+    int delta_y = 0;
+    int radius = 200;
+    int radius_end = 200;
+    int rotation = 0;           // degrees, positive turns from +x towards +y
+    UInt32 duration = 300;      // ms
+    UInt32 rate = 100;          // reports per second
+    int noise = 0;              // logical units, each coordinate moves by up to +-noise
+    UInt32 seed = 1;
+    UInt32 pause = 0;           // ms between the previous report and the first one
+};
+
+class FocalTechGestureGenerator {
+ public:
+    FocalTechGestureGenerator(UInt8* trace, size_t capacity) : trace(trace), capacity(capacity), used(0) {}
+
+    /* @return *true* if the gesture can be rendered */
+
+    static bool isValid(const FocalTechGesture& gesture) {
+        int min_fingers = (gesture.kind == kGesturePinch || gesture.kind == kGestureRotate) ? 2 : 1;
+        return gesture.fingers >= min_fingers && gesture.fingers <= FOCALTECH_MAX_FINGERS &&
+               gesture.rate >= 1 && gesture.rate <= kGestureMaxRate && gesture.duration <= kGestureMaxDuration &&
+               (uint64_t)gesture.pause * 1000 <= kReplayMaxDelay && gesture.noise >= 0;
+    }
+
+    /* The number of trace bytes *gesture* renders to, the lift report included */
+
+    static size_t traceLength(const FocalTechGesture& gesture) {
+        size_t length = gesture.fingers > 2 ? kPacketLengthLarge : kPacketLengthSmall;
+        return reports(gesture) * (kReplayRecordHeader + length) + kReplayRecordHeader + kPacketLengthSmall;
+    }
+
+    /* Where finger *finger* of *gesture* is *elapsed* microseconds after it started, without noise
+     *
+     * This is the ground truth of the trace, positions may lie outside the logical range and are clamped when encoded.
+     */
+
+    static void position(const FocalTechGesture& gesture, int finger, uint64_t elapsed, int* x, int* y) {
+        uint64_t duration = (uint64_t)gesture.duration * 1000;
+        SInt64 progress = (duration && elapsed < duration) ? (SInt64)((elapsed << 16) / duration) : 0x10000;
+
+        switch (gesture.kind) {
+            case kGesturePinch:
+            case kGestureRotate: {
+                SInt64 radius = gesture.radius;
+                SInt64 angle = ((SInt64)finger << kGestureAngleShift) / gesture.fingers;
+                if (gesture.kind == kGesturePinch)
+                    radius += ((SInt64)(gesture.radius_end - gesture.radius) * progress) >> 16;
+                else
+                    angle += (SInt64)gesture.rotation * (1 << kGestureAngleShift) / 360 * progress >> 16;
+                *x = gesture.center_x + (int)((radius * cosine(angle)) >> kGestureTrigShift);
+                *y = gesture.center_y + (int)((radius * sine(angle)) >> kGestureTrigShift);
+                break;
+            }
+            default: {
+                *x = gesture.center_x + (2 * finger - (gesture.fingers - 1)) * kGestureFingerSpacing / 2;
+                *y = gesture.center_y;
+                if (gesture.kind != kGestureTap) {
+                    *x += (int)((gesture.delta_x * progress) >> 16);
+                    *y += (int)((gesture.delta_y * progress) >> 16);
+                }
+                break;
+            }
+        }
+    }
+
+    /* Appends the reports of *gesture* to the trace
+     *
+     * @return *false* if the gesture is not valid or does not fit, the trace is left unchanged then
+     */
+
+    bool add(const FocalTechGesture& gesture) {
+        if (!isValid(gesture) || capacity - used < traceLength(gesture))
+            return false;
+
+        UInt32 period = 1000000 / gesture.rate;
+        UInt32 count = reports(gesture);
+        UInt32 buttons = (gesture.kind == kGestureDrag) ? FOCALTECH_BUTTON_LEFT : 0;
+        UInt32 random = gesture.seed ? gesture.seed : 1;
+        focaltech_hw_state fingers[FOCALTECH_MAX_FINGERS] = {};
+        UInt8 packet[kPacketLengthMax];
+
+        for (UInt32 i = 0; i < count; i++) {
+            for (int j = 0; j < gesture.fingers; j++) {
+                int x, y;
+                position(gesture, j, (uint64_t)i * period, &x, &y);
+                fingers[j].x = clamp(x + jitter(&random, gesture.noise), LOGICAL_MAX_X);
+                fingers[j].y = clamp(y + jitter(&random, gesture.noise), LOGICAL_MAX_Y);
+                fingers[j].valid = true;
+            }
+            append(i ? period : gesture.pause * 1000, packet, encodeFocalTechPacket(fingers, buttons, packet));
+        }
+
+        for (int j = 0; j < FOCALTECH_MAX_FINGERS; j++)
+            fingers[j].valid = false;
+        append(period, packet, encodeFocalTechPacket(fingers, 0, packet));
+        return true;
+    }
+
+    size_t length() const {
+        return used;
+    }
+
+ private:
+    UInt8* trace;
+    size_t capacity;
+    size_t used;
+
+    // quarter wave, sin(i/256 turn) in Q14
+    static SInt64 quarterSine(SInt64 angle) {
+        static const SInt16 table[65] = {
+            0, 402, 804, 1205, 1606, 2006, 2404, 2801, 3196,
+            3590, 3981, 4370, 4756, 5139, 5520, 5897, 6270, 6639,
+            7005, 7366, 7723, 8076, 8423, 8765, 9102, 9434, 9760,
+            10080, 10394, 10702, 11003, 11297, 11585, 11866, 12140, 12406,
+            12665, 12916, 13160, 13395, 13623, 13842, 14053, 14256, 14449,
+            14635, 14811, 14978, 15137, 15286, 15426, 15557, 15679, 15791,
+            15893, 15986, 16069, 16143, 16207, 16261, 16305, 16340, 16364,
+            16379, 16384
+        };
+        SInt64 index = angle >> 8, fraction = angle & 0xff;
+        if (index >= 64)
+            return table[64];
+        return table[index] + (((table[index + 1] - table[index]) * fraction) >> 8);
+    }
+
+    static SInt64 sine(SInt64 angle) {
+        angle &= 0xffff;
+        SInt64 quarter = angle & 0x3fff;
+        switch (angle >> 14) {
+            case 0:  return quarterSine(quarter);
+            case 1:  return quarterSine(0x4000 - quarter);
+            case 2:  return -quarterSine(quarter);
+            default: return -quarterSine(0x4000 - quarter);
+        }
+    }
+
+    static SInt64 cosine(SInt64 angle) {
+        return sine(angle + 0x4000);
+    }
+
+    static UInt32 reports(const FocalTechGesture& gesture) {
+        return (UInt32)((uint64_t)gesture.duration * gesture.rate / 1000) + 1;
+    }
+
+    // xorshift32, uniform in -noise .. noise
+    static int jitter(UInt32* random, int noise) {
+        if (!noise)
+            return 0;
+        *random ^= *random << 13;
+        *random ^= *random >> 17;
+        *random ^= *random << 5;
+        return (int)(*random % (2 * (UInt32)noise + 1)) - noise;
+    }
+
+    static int clamp(int value, int max) {
+        return value < 0 ? 0 : (value > max ? max : value);
+    }
+
+    void append(UInt32 delay, const UInt8* packet, int length) {
+        used += appendFocalTechRecord(trace + used, capacity - used, delay, packet, length);
+    }
+};
+
+#endif /* VoodooPS2FocalTechGesture_hpp */
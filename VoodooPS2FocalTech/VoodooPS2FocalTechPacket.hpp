@@ -0,0 +1,124 @@
+//
+//  VoodooPS2FocalTechPacket.hpp
+//  VoodooPS2FocalTech
+//
+//  Copyright © 2026 chilledHamza. All rights reserved.
+//
+
+#ifndef VoodooPS2FocalTechPacket_hpp
+#define VoodooPS2FocalTechPacket_hpp
+
+#include <IOKit/IOLib.h>
+#include <libkern/OSByteOrder.h>
+
+#define FOCALTECH_MAX_FINGERS 4
+
+#define kPacketLengthSmall  8
+#define kPacketLengthLarge  16
+#define kPacketLengthMax    16
+
+#define LOGICAL_MAX_X       0x08E0
+#define LOGICAL_MAX_Y       0x03E0
+
+// Packet layout
+//
+// byte 0        : bit 0 left button, bit 1 right button, bit 3 always set,
+//                 bits 4-5 packet kind
+// slot n (0..3) : bytes 4n+1 .. 4n+3, X[11:4] Y[11:4] X[3:0]|Y[3:0]
+//                 all three bytes 0xff when the slot holds no finger
+// byte 4        : finger count, bits 0-1 and bits 4-5 (shifted down by 2)
+//
+// Packets announcing more than two fingers are sent as 16-byte packets (two
+// 8-byte halves), the upper half of an 8-byte packet is treated as invalid.
+
+#define FOCALTECH_BUTTON_LEFT       0x01
+#define FOCALTECH_BUTTON_RIGHT      0x02
+#define FOCALTECH_BUTTON_MASK       0x03
+#define FOCALTECH_SYNC_BIT          0x08
+#define FOCALTECH_KIND_MASK         0x30
+#define FOCALTECH_KIND_NO_CONTACTS  0x10
+#define FOCALTECH_SLOT_SIZE         4
+#define FOCALTECH_SLOT_INVALID      0xff
+
+#define FOCALTECH_FINGER_COUNT(b)   ((int)((b) & 3) + (((b) & 48) >> 2))
+#define FOCALTECH_HAS_CONTACTS(p)   (((p)[0] & FOCALTECH_KIND_MASK) != FOCALTECH_KIND_NO_CONTACTS)
+#define FOCALTECH_SLOT(p, n)        (&(p)[(n) * FOCALTECH_SLOT_SIZE + 1])
+#define FOCALTECH_SLOT_VALID(s)     (!((s)[0] == FOCALTECH_SLOT_INVALID && (s)[1] == FOCALTECH_SLOT_INVALID && (s)[2] == FOCALTECH_SLOT_INVALID))
+#define FOCALTECH_SLOT_X(s)         (((s)[0] << 4) | (((s)[2] & 0xf0) >> 4))
+#define FOCALTECH_SLOT_Y(s)         (((s)[1] << 4) | ((s)[2] & 0x0f))
+
+struct focaltech_hw_state {
+    int x;
+    int y;
+    bool valid;
+};
+
+// Replay traces are a sequence of records: delay before the packet in us
+// (UInt32, little endian), packet length (UInt8), the packet bytes as the
+// device sent them.
+#define kReplayRecordHeader     5
+#define kReplayMaxDelay         1000000 // us
+
+/* Encodes what <ApplePS2FocalTechTouchPad::parsePacket> decodes
+ * @fingers The state of every slot, FOCALTECH_MAX_FINGERS entries
+ * @buttons FOCALTECH_BUTTON_LEFT and FOCALTECH_BUTTON_RIGHT
+ * @packet Receives the packet, kPacketLengthMax bytes
+ *
+ * Parsing the packet yields *fingers* and *buttons* again, a lift is a contact report without valid slots. Coordinates
+ * outside the logical range and fingers in slots 2-3 of a packet announcing at most two fingers (an 8-byte packet, whose
+ * upper half is discarded) have no encoding.
+ *
+ * @return The packet length, 0 if the state has no encoding
+ */
+
+static inline int encodeFocalTechPacket(const focaltech_hw_state* fingers, UInt32 buttons, UInt8* packet) {
+    int count = 0;
+    for (int i = 0; i < FOCALTECH_MAX_FINGERS; i++) {
+        if (!fingers[i].valid)
+            continue;
+        if (fingers[i].x < 0 || fingers[i].x > LOGICAL_MAX_X || fingers[i].y < 0 || fingers[i].y > LOGICAL_MAX_Y)
+            return 0;
+        count++;
+    }
+
+    int length = count > 2 ? kPacketLengthLarge : kPacketLengthSmall;
+    for (int i = 0; i < FOCALTECH_MAX_FINGERS; i++) {
+        UInt8* slot = FOCALTECH_SLOT(packet, i);
+        if (!fingers[i].valid) {
+            slot[0] = slot[1] = slot[2] = FOCALTECH_SLOT_INVALID;
+            continue;
+        }
+        if (slot + FOCALTECH_SLOT_SIZE - 1 > packet + length)
+            return 0;
+        slot[0] = fingers[i].x >> 4;
+        slot[1] = fingers[i].y >> 4;
+        slot[2] = ((fingers[i].x & 0x0f) << 4) | (fingers[i].y & 0x0f);
+    }
+
+    // any kind but FOCALTECH_KIND_NO_CONTACTS is a contact report
+    packet[0] = FOCALTECH_SYNC_BIT | (buttons & FOCALTECH_BUTTON_MASK);
+    packet[4] = (count & 3) | ((count >> 2) << 4);
+    // the second half repeats the header bytes, parsePacket ignores both
+    packet[8] = packet[0];
+    packet[12] = packet[4];
+
+    return length;
+}
+
+/* Appends one replay record to *trace*, see kReplayRecordHeader
+ * @delay Microseconds since the previous record
+ *
+ * @return The record length, 0 if it does not fit into *capacity* bytes
+ */
+
+static inline size_t appendFocalTechRecord(UInt8* trace, size_t capacity, UInt32 delay, const UInt8* packet, int length) {
+    if (capacity < kReplayRecordHeader + (size_t)length)
+        return 0;
+
+    OSWriteLittleInt32(trace, 0, delay);
+    trace[4] = length;
+    memcpy(trace + kReplayRecordHeader, packet, length);
+    return kReplayRecordHeader + length;
+}
+
+#endif /* VoodooPS2FocalTechPacket_hpp */